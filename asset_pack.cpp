@@ -0,0 +1,116 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <string>
+#include <vector>
+
+#include "asset_pack.hpp"
+
+// Turns asset files into either the header that compiles them into the game
+// (--header) or an override pack the game maps at runtime (--pack). Assets are
+// named by the path given on the command line, so run it from the repository
+// root. The pack format is described in asset_pack.hpp.
+
+static bool ReadFile(const char* path, std::vector<uint8_t>& out) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        return false;
+    }
+    out.assign(file.data, file.data + file.size);
+    return true;
+}
+
+static bool WriteHeader(const char* out, int count, char* paths[]) {
+    FILE* file = fopen(out, "w");
+    if (!file) {
+        return false;
+    }
+    fprintf(file, "#pragma once\n\n// Generated by asset_pack.exe --header; do not edit\n\n");
+    for (int i = 0; i < count; ++i) {
+        std::vector<uint8_t> bytes;
+        if (!ReadFile(paths[i], bytes)) {
+            fprintf(stderr, "Failed to read %s\n", paths[i]);
+            fclose(file);
+            return false;
+        }
+        fprintf(file, "// %s\nalignas(16) static constexpr uint8_t EmbeddedAsset%d[] = {", paths[i], i);
+        for (size_t b = 0; b < bytes.size(); ++b) {
+            fprintf(file, "%s0x%02x,", b % 16 == 0 ? "\n    " : " ", bytes[b]);
+        }
+        fprintf(file, "\n};\n\n");
+    }
+    fprintf(file, "static constexpr Asset EmbeddedAssets[] = {\n");
+    for (int i = 0; i < count; ++i) {
+        fprintf(file, "    {\"%s\", EmbeddedAsset%d, sizeof(EmbeddedAsset%d)},\n", paths[i], i, i);
+    }
+    fprintf(file, "};\n");
+    return fclose(file) == 0;
+}
+
+static bool WritePack(const char* out, int count, char* paths[]) {
+    std::vector<AssetPackEntry> entries(static_cast<size_t>(count));
+    std::vector<std::vector<uint8_t>> contents(static_cast<size_t>(count));
+    uint64_t offset = sizeof(AssetPackHeader) + entries.size() * sizeof(AssetPackEntry);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (strlen(paths[i]) >= sizeof(entries[i].name)) {
+            fprintf(stderr, "Asset name too long: %s\n", paths[i]);
+            return false;
+        }
+        if (!ReadFile(paths[i], contents[i])) {
+            fprintf(stderr, "Failed to read %s\n", paths[i]);
+            return false;
+        }
+        memset(&entries[i], 0, sizeof(entries[i]));
+        strcpy(entries[i].name, paths[i]);
+        entries[i].offset = offset;
+        entries[i].size = contents[i].size();
+        offset += contents[i].size();
+    }
+
+    FILE* file = fopen(out, "wb");
+    if (!file) {
+        return false;
+    }
+    AssetPackHeader header{};
+    memcpy(header.magic, AssetPackMagic, sizeof(header.magic));
+    header.version = AssetPackVersion;
+    header.count = static_cast<uint32_t>(count);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok &= fwrite(entries.data(), sizeof(entries[0]), entries.size(), file) == entries.size();
+    for (std::vector<uint8_t> const& bytes : contents) {
+        ok &= fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    }
+    ok &= fclose(file) == 0;
+    return ok;
+}
+
+
+void Usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s --header OUT FILE...   write a header embedding the files\n"
+        "       %s --pack OUT FILE...     write an override pack\n",
+        program, program);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4) {
+        Usage(argv[0]);
+        return 1;
+    }
+    const char* mode = argv[1];
+    const char* out = argv[2];
+    bool ok;
+    if (strcmp(mode, "--header") == 0) ok = WriteHeader(out, argc - 3, argv + 3);
+    else if (strcmp(mode, "--pack") == 0) ok = WritePack(out, argc - 3, argv + 3);
+    else {
+        Usage(argv[0]);
+        return 1;
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", out);
+        return 1;
+    }
+    return 0;
+}
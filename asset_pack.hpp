@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "mapped_file.hpp"
+
+// Override packs replace compiled-in assets without a rebuild. They are
+// memory-mapped, so only the pages used are read. asset_pack.exe writes them.
+//
+// Layout, little-endian:
+//   header   "TTRSPACK", u32 version, u32 entry count
+//   entries  AssetPackEntry per asset
+//   data     asset bytes at the offsets the entries give
+
+struct Asset {
+    const char* name;  // Path relative to the repository, e.g. fonts/X.TTF
+    const uint8_t* data;
+    size_t size;
+};
+
+struct AssetPackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+};
+
+struct AssetPackEntry {
+    char name[48];
+    uint64_t offset;
+    uint64_t size;
+};
+
+static constexpr char AssetPackMagic[8] = {'T', 'T', 'R', 'S', 'P', 'A', 'C', 'K'};
+static constexpr uint32_t AssetPackVersion = 1;
+
+
+struct AssetPack {
+    MappedFile file;
+    size_t count = 0;
+
+    bool Open(const char* path) {
+        count = 0;
+        if (!file.Open(path) || file.size < sizeof(AssetPackHeader)) {
+            return false;
+        }
+        AssetPackHeader header;
+        memcpy(&header, file.data, sizeof(header));
+        if (memcmp(header.magic, AssetPackMagic, sizeof(header.magic)) != 0 ||
+            header.version != AssetPackVersion ||
+            sizeof(header) + header.count * sizeof(AssetPackEntry) > file.size) {
+            file.Close();
+            return false;
+        }
+        for (size_t i = 0; i < header.count; ++i) {
+            AssetPackEntry entry = Entry(i);
+            if (entry.offset > file.size || entry.size > file.size - entry.offset ||
+                entry.name[sizeof(entry.name) - 1] != '\0') {
+                file.Close();
+                return false;
+            }
+        }
+        count = header.count;
+        return true;
+    }
+
+    AssetPackEntry Entry(size_t i) const {
+        AssetPackEntry entry;
+        memcpy(&entry, file.data + sizeof(AssetPackHeader) + i * sizeof(entry), sizeof(entry));
+        return entry;
+    }
+
+    bool Find(const char* name, Asset& asset) const {
+        for (size_t i = 0; i < count; ++i) {
+            AssetPackEntry entry = Entry(i);
+            if (strcmp(entry.name, name) == 0) {
+                asset = {name, file.data + entry.offset, static_cast<size_t>(entry.size)};
+                return true;
+            }
+        }
+        return false;
+    }
+};
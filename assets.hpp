@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstring>
+
+#include "asset_pack.hpp"
+
+// Game assets are compiled into the binary (assets_embedded.hpp, generated by
+// asset_pack.exe from build.sh), so nothing is read from disk at startup. An
+// override pack can replace any of them; see asset_pack.hpp.
+#include "assets_embedded.hpp"
+
+inline AssetPack assetOverrides;
+
+// The override pack's copy if it has one, otherwise the embedded one
+inline bool FindAsset(const char* name, Asset& asset) {
+    if (assetOverrides.Find(name, asset)) {
+        return true;
+    }
+    for (Asset const& embedded : EmbeddedAssets) {
+        if (strcmp(embedded.name, name) == 0) {
+            asset = embedded;
+            return true;
+        }
+    }
+    return false;
+}
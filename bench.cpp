@@ -0,0 +1,438 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// The render benchmarks use whichever backend the build has: SDL with
+// -DBENCH_SDL (on the dummy video driver unless SDL_VIDEODRIVER is set), the
+// terminal backend on Linux, or none.
+#if defined(BENCH_SDL)
+#include "platform_sdl.hpp"
+#elif defined(__linux__)
+#include "platform_terminal_linux.hpp"
+#define BENCH_TERMINAL 1
+#endif
+
+#include "tetris.hpp"
+#include "bot.hpp"
+
+// Engine and renderer benchmarks. Microbenchmarks run each operation over a
+// fixed corpus of boards taken from seeded bot games, so runs are comparable
+// across builds; every figure is the best of --repeats runs. Results are
+// written as JSON and, given --baseline, compared against an earlier run.
+
+static constexpr int8_t Width = 10;
+static constexpr int8_t Height = 20;
+
+using Game = Tetris<Width, Height>;
+using Tetromino = Game::Tetromino;
+
+static volatile uint64_t sink;
+
+struct Result {
+    std::string name;
+    double value;
+    const char* unit;
+    bool higherIsBetter;
+};
+
+static size_t repeats = 5;
+
+// Best of the repeats, in nanoseconds per operation. fn() returns the number
+// of operations it performed.
+template<typename Fn>
+double NanosecondsPerOp(Fn&& fn) {
+    double best = 1e300;
+    for (size_t r = 0; r < repeats; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        size_t ops = fn();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / static_cast<double>(std::max<size_t>(ops, 1)));
+    }
+    return best;
+}
+
+// Positions from seeded games under garbage, so the corpus covers low, ragged
+// and nearly dead stacks
+static std::vector<Game> BuildCorpus(size_t size) {
+    std::vector<Game> corpus;
+    Bot<> bot;
+    for (uint64_t seed = 1; corpus.size() < size; ++seed) {
+        Game game(seed);
+        std::minstd_rand holeRng(static_cast<uint32_t>(seed));
+        for (size_t pieces = 0; !game.gameOver && corpus.size() < size; ++pieces) {
+            if (pieces % 5 == 0) {
+                corpus.push_back(game);
+            }
+            bot.Move(game);
+            if (pieces % 3 == 0) {
+                game.AddGarbage(1, static_cast<int8_t>(holeRng() % 10));
+            }
+        }
+    }
+    return corpus;
+}
+
+static void MicroBenchmarks(std::vector<Game> const& corpus, std::vector<Result>& results) {
+    results.push_back({"PieceHitWall", NanosecondsPerOp([&] {
+        size_t ops = 0;
+        uint64_t hits = 0;
+        for (size_t pass = 0; pass < 50; ++pass) {
+            for (Game const& game : corpus) {
+                Tetromino piece = game.currentPiece;
+                for (int8_t rotation = 0; rotation < 4; ++rotation) {
+                    piece.rotation = rotation;
+                    for (int8_t px = -2; px < 12; ++px) {
+                        piece.px = px;
+                        hits += game.PieceHitWall(piece, 0, 1);
+                        ++ops;
+                    }
+                }
+            }
+        }
+        sink = hits;
+        return ops;
+    }), "ns/op", false});
+
+    // Rotations at the bottom of the drop, where kicks are most likely
+    std::vector<Tetromino> landed;
+    for (Game const& game : corpus) {
+        Tetromino piece = game.currentPiece;
+        if (!game.PieceHitWall(piece)) {
+            piece.py += game.DistanceFromFloor(piece);
+        }
+        landed.push_back(piece);
+    }
+    results.push_back({"Rotate", NanosecondsPerOp([&] {
+        size_t ops = 0;
+        uint64_t sum = 0;
+        for (size_t pass = 0; pass < 200; ++pass) {
+            for (size_t i = 0; i < corpus.size(); ++i) {
+                Tetromino piece = landed[i];
+                corpus[i].Rotate(piece, pass & 1);
+                sum += static_cast<uint64_t>(piece.px + piece.py + piece.rotation);
+                ++ops;
+            }
+        }
+        sink = sum;
+        return ops;
+    }), "ns/op", false});
+
+    results.push_back({"DistanceFromFloor", NanosecondsPerOp([&] {
+        size_t ops = 0;
+        uint64_t sum = 0;
+        for (size_t pass = 0; pass < 50; ++pass) {
+            for (Game const& game : corpus) {
+                Tetromino piece = game.currentPiece;
+                for (int8_t rotation = 0; rotation < 4; ++rotation) {
+                    piece.rotation = rotation;
+                    for (int8_t px = -2; px < 12; ++px) {
+                        piece.px = px;
+                        if (!game.PieceHitWall(piece)) {
+                            sum += static_cast<uint64_t>(game.DistanceFromFloor(piece));
+                            ++ops;
+                        }
+                    }
+                }
+            }
+        }
+        sink = sum;
+        return ops;
+    }), "ns/op", false});
+
+    // Each position with its bottom 1-4 rows completed. Copying the game is
+    // timed on its own and taken off.
+    std::vector<Game> full;
+    for (size_t i = 0; i < corpus.size(); ++i) {
+        Game game = corpus[i];
+        int8_t rows = static_cast<int8_t>(1 + i % 4);
+        for (int8_t y = Height - rows; y < Height; ++y) {
+            for (int8_t x = 0; x < Width; ++x) {
+                if (game.board[y][x] == Tetromino::Type::None) {
+                    game.SetCell(x, y, Tetromino::Type::Garbage);
+                }
+            }
+        }
+        full.push_back(game);
+    }
+    Game work;
+    double copy = NanosecondsPerOp([&] {
+        for (size_t pass = 0; pass < 20; ++pass) {
+            for (Game const& game : full) {
+                work = game;
+                sink = work.hash;
+            }
+        }
+        return 20 * full.size();
+    });
+    double clear = NanosecondsPerOp([&] {
+        for (size_t pass = 0; pass < 20; ++pass) {
+            for (Game const& game : full) {
+                work = game;
+                work.ClearLines();
+                sink = work.hash;
+            }
+        }
+        return 20 * full.size();
+    });
+    results.push_back({"ClearLines", std::max(0.0, clear - copy), "ns/op", false});
+
+    results.push_back({"NextFromBag", NanosecondsPerOp([&] {
+        Game game(1);
+        uint64_t sum = 0;
+        for (size_t i = 0; i < 100000; ++i) {
+            sum += game.NextFromBag();
+        }
+        sink = sum;
+        return size_t{100000};
+    }), "ns/op", false});
+
+    results.push_back({"DimColor", NanosecondsPerOp([&] {
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < 100000; ++i) {
+            Color color = Palette::Base[i % (Palette::White + 1)];
+            sum += color.DimColor(static_cast<uint8_t>(i + sink));
+        }
+        sink = sum;
+        return size_t{100000};
+    }), "ns/op", false});
+}
+
+// Uniformly random legal placements until the game ends
+template<int8_t W=Width, int8_t H=Height>
+static size_t PlayRandomGame(uint64_t seed) {
+    using Placer = Bot<W, H>;
+    Tetris<W, H> game(seed);
+    std::minstd_rand rng(static_cast<uint32_t>(seed));
+    std::vector<typename Placer::Placement> placements;
+    size_t pieces = 0;
+    while (!game.gameOver) {
+        placements.clear();
+        Placer::ForEachPlacement(game, [&](typename Placer::Placement placement) {
+            placements.push_back(placement);
+        });
+        Placer::Apply(game, placements[rng() % placements.size()]);
+        ++pieces;
+    }
+    return pieces;
+}
+
+template<int8_t W=Width, int8_t H=Height>
+static double RandomGamesPerSecond(uint64_t games) {
+    return 1e9 / NanosecondsPerOp([&] {
+        uint64_t pieces = 0;
+        for (uint64_t seed = 1; seed <= games; ++seed) {
+            pieces += PlayRandomGame<W, H>(seed);
+        }
+        sink = pieces;
+        return static_cast<size_t>(games);
+    });
+}
+
+static void MacroBenchmarks(std::vector<Result>& results) {
+    results.push_back({"RandomGames", RandomGamesPerSecond(200), "games/s", true});
+    // The custom-mode board sizes
+    results.push_back({"RandomGames16x24", RandomGamesPerSecond<16, 24>(50), "games/s", true});
+    results.push_back({"RandomGames40x20", RandomGamesPerSecond<40, 20>(10), "games/s", true});
+
+    double perPiece = NanosecondsPerOp([&] {
+        Game game(1);
+        Bot<> bot;
+        size_t pieces = 0;
+        for (; pieces < 500 && !game.gameOver; ++pieces) {
+            bot.Move(game);
+        }
+        sink = game.hash;
+        return pieces;
+    });
+    results.push_back({"BotPieces", 1e9 / perPiece, "pieces/s", true});
+}
+
+#if defined(BENCH_SDL) || defined(BENCH_TERMINAL)
+static void RenderBenchmarks(std::vector<Game> const& corpus, std::vector<Result>& results) {
+#ifdef BENCH_SDL
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    InitializeScreen();
+#else
+    // Frames go to /dev/null; one pass into a temporary file counts the bytes
+    fflush(stdout);
+    int savedStdout = dup(1);
+    FILE* counter = tmpfile();
+    dup2(fileno(counter), 1);
+#endif
+    {
+        Screen<18, 22> screen;
+        results.push_back({"Draw", 1e9 / NanosecondsPerOp([&] {
+            for (size_t pass = 0; pass < 20; ++pass) {
+                for (Game const& game : corpus) {
+                    game.Draw(screen);
+                }
+            }
+            return 20 * corpus.size();
+        }), "frames/s", true});
+
+#ifdef BENCH_TERMINAL
+        fflush(stdout);
+        off_t before = lseek(1, 0, SEEK_CUR);
+        for (Game const& game : corpus) {
+            game.Draw(screen);
+            screen.RedrawScreen();
+        }
+        fflush(stdout);
+        double bytes = static_cast<double>(lseek(1, 0, SEEK_CUR) - before) / static_cast<double>(corpus.size());
+        results.push_back({"TerminalFrameBytes", bytes, "bytes/frame", false});
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, 1);
+        close(devNull);
+#endif
+
+        results.push_back({"DrawAndRedraw", 1e9 / NanosecondsPerOp([&] {
+            for (Game const& game : corpus) {
+                game.Draw(screen);
+                screen.RedrawScreen();
+#ifdef BENCH_SDL
+                SDL_RenderPresent(screen.GetRenderer());
+#else
+                fflush(stdout);
+#endif
+            }
+            return corpus.size();
+        }), "frames/s", true});
+    }
+#ifdef BENCH_SDL
+    DestroyScreen();
+#else
+    dup2(savedStdout, 1);
+    close(savedStdout);
+    fclose(counter);
+#endif
+}
+#endif
+
+
+static void WriteJson(FILE* file, std::vector<Result> const& results) {
+    fprintf(file, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        Result const& r = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"value\": %.6g, \"unit\": \"%s\", \"higher_is_better\": %s}%s\n",
+                r.name.c_str(), r.value, r.unit, r.higherIsBetter ? "true" : "false",
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+// Reads back what WriteJson writes, one benchmark per line
+static bool ReadJson(const char* path, std::vector<Result>& results) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        char name[128];
+        double value;
+        if (sscanf(line, " {\"name\": \"%127[^\"]\", \"value\": %lf", name, &value) == 2) {
+            results.push_back({name, value, "", strstr(line, "\"higher_is_better\": true") != nullptr});
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+// Prints every benchmark with its change from the baseline and returns the
+// number that got worse by more than threshold percent
+static size_t Compare(std::vector<Result> const& results, std::vector<Result> const& baseline, double threshold) {
+    size_t regressions = 0;
+    fprintf(stderr, "%-20s %14s %14s %9s\n", "benchmark", "value", "baseline", "change");
+    for (Result const& r : results) {
+        auto base = std::find_if(baseline.begin(), baseline.end(), [&](Result const& b) { return b.name == r.name; });
+        if (base == baseline.end() || base->value == 0) {
+            fprintf(stderr, "%-20s %14.4g %14s %9s  %s\n", r.name.c_str(), r.value, "-", "-", r.unit);
+            continue;
+        }
+        double change = (r.value - base->value) / base->value * 100;
+        bool worse = r.higherIsBetter ? change < -threshold : change > threshold;
+        regressions += worse;
+        fprintf(stderr, "%-20s %14.4g %14.4g %+8.1f%%  %s%s\n", r.name.c_str(), r.value, base->value, change,
+                r.unit, worse ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+
+void Usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --out F        write results as JSON to F (default: stdout)\n"
+        "  --baseline F   compare against an earlier --out file\n"
+        "  --threshold P  percent change that counts as a regression (default 10)\n"
+        "  --repeats N    runs per benchmark, best one kept (default 5)\n"
+        "  --corpus N     boards in the microbenchmark corpus (default 256)\n",
+        program);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* out = nullptr;
+    const char* baselinePath = nullptr;
+    double threshold = 10;
+    size_t corpusSize = 256;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i+1 < argc ? argv[++i] : nullptr;
+        if (!value) {
+            Usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "--out") == 0) out = value;
+        else if (strcmp(arg, "--baseline") == 0) baselinePath = value;
+        else if (strcmp(arg, "--threshold") == 0) threshold = strtod(value, nullptr);
+        else if (strcmp(arg, "--repeats") == 0) repeats = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--corpus") == 0) corpusSize = std::max(1ull, strtoull(value, nullptr, 10));
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Result> baseline;
+    if (baselinePath && !ReadJson(baselinePath, baseline)) {
+        fprintf(stderr, "Failed to read %s\n", baselinePath);
+        return 1;
+    }
+
+    std::vector<Game> corpus = BuildCorpus(corpusSize);
+    std::vector<Result> results;
+    MicroBenchmarks(corpus, results);
+    MacroBenchmarks(results);
+#if defined(BENCH_SDL) || defined(BENCH_TERMINAL)
+    RenderBenchmarks(corpus, results);
+#endif
+
+    if (out) {
+        FILE* file = fopen(out, "w");
+        if (!file) {
+            fprintf(stderr, "Failed to create %s\n", out);
+            return 1;
+        }
+        WriteJson(file, results);
+        fclose(file);
+    }
+    else {
+        WriteJson(stdout, results);
+    }
+
+    size_t regressions = Compare(results, baseline, threshold);
+    if (regressions > 0) {
+        fprintf(stderr, "%zu benchmark(s) regressed by more than %g%%\n", regressions, threshold);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "tetris.hpp"
+#include "parallel.hpp"
+#include "transposition.hpp"
+
+
+struct BotWeights {
+    enum Feature : size_t {
+        AggregateHeight = 0, Lines, Holes, Bumpiness, COUNT,
+    };
+
+    // Positive weights reward a feature, negative ones penalise it
+    double w[COUNT] = {-0.510066, 0.760666, -0.35663, -0.184483};
+
+    // Reads "height,lines,holes,bumpiness"
+    static bool Parse(const char* text, BotWeights& out) {
+        BotWeights result;
+        for (size_t i = 0; i < COUNT; ++i) {
+            char* end;
+            result.w[i] = strtod(text, &end);
+            if (end == text) {
+                return false;
+            }
+            text = end;
+            if (i+1 < COUNT) {
+                if (*text != ',') {
+                    return false;
+                }
+                ++text;
+            }
+        }
+        if (*text != '\0') {
+            return false;
+        }
+        out = result;
+        return true;
+    }
+
+    void Print(FILE* file) const {
+        for (size_t i = 0; i < COUNT; ++i) {
+            fprintf(file, i == 0 ? "%.6f" : ",%.6f", w[i]);
+        }
+    }
+};
+
+
+// Placement bot. Tries every rotation and column of the current piece and of
+// the hold piece, drops it straight down from the spawn row and keeps the
+// placement whose resulting board scores best. With depth > 1 it looks that
+// many pieces ahead through the queue; positions reached along different
+// orders are searched once when a transposition table is given, and the root
+// placements can be split over several threads sharing that table.
+template<int8_t Width=10, int8_t Height=20>
+struct Bot {
+    using Game = Tetris<Width, Height>;
+    using Tetromino = typename Game::Tetromino;
+
+    struct Placement {
+        Tetromino piece;
+        bool hold = false;
+    };
+
+    BotWeights weights;
+    size_t depth = 1;  // Pieces searched, including the current one
+    size_t threads = 1;
+    // Keyed by the position hash, so it must only be shared by one game
+    TranspositionTable* table = nullptr;
+
+    // The position hash plus whether hold is still available, which changes
+    // what can be reached from it
+    static uint64_t TableKey(Game const& game) {
+        static constexpr uint64_t HoldUsed = 0xC2B2AE3D27D4EB4Full;
+        return game.hash ^ (game.alreadySwapped ? HoldUsed : 0);
+    }
+
+    double Evaluate(Game const& game) const {
+        if (game.gameOver) {
+            return -std::numeric_limits<double>::infinity();
+        }
+
+        int aggregateHeight = 0;
+        int holes = 0;
+        int bumpiness = 0;
+        int prevHeight = -1;
+        // A hole is an empty cell with a filled one somewhere above it
+        typename Game::Row covered = 0;
+        for (int8_t y = *std::min_element(game.columnTop, game.columnTop + Width); y < Height; ++y) {
+            holes += std::popcount(static_cast<typename Game::Row>(covered & ~game.rowBits[y]));
+            covered |= game.rowBits[y];
+        }
+        for (int8_t x = 0; x < Width; ++x) {
+            int height = Height - game.columnTop[x];
+            aggregateHeight += height;
+            if (prevHeight >= 0) {
+                bumpiness += abs(height - prevHeight);
+            }
+            prevHeight = height;
+        }
+
+        return weights.w[BotWeights::AggregateHeight] * aggregateHeight +
+            weights.w[BotWeights::Lines] * game.lastLinesCleared +
+            weights.w[BotWeights::Holes] * holes +
+            weights.w[BotWeights::Bumpiness] * bumpiness;
+    }
+
+    // Can the piece be shifted along the spawn row from the spawn column?
+    static bool Reachable(Game const& game, Tetromino piece) {
+        Tetromino spawn = piece;
+        spawn.px = Tetromino{piece.type}.px;
+        if (game.PieceHitWall(spawn)) {
+            return false;
+        }
+        int8_t step = piece.px > spawn.px ? 1 : -1;
+        while (spawn.px != piece.px) {
+            spawn.px += step;
+            if (game.PieceHitWall(spawn)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The type that would be in play after pressing hold
+    static typename Tetromino::Type HoldType(Game const& game) {
+        if (game.holdType != Tetromino::Type::None) {
+            return game.holdType;
+        }
+        return game.pieceQueue[game.pieceQueueTop];
+    }
+
+    // Calls fn(placement) for every placement reachable from the spawn row
+    static void ForEachPlacement(Game const& game, auto&& fn) {
+        for (int hold = 0; hold < 2; ++hold) {
+            if (hold && game.alreadySwapped) {
+                break;
+            }
+            typename Tetromino::Type type = hold ? HoldType(game) : game.currentPiece.type;
+            for (int8_t rotation = 0; rotation < 4; ++rotation) {
+                for (int8_t px = -2; px < Width+2; ++px) {
+                    Tetromino piece{type};
+                    piece.rotation = rotation;
+                    piece.px = px;
+                    if (Reachable(game, piece)) {
+                        fn(Placement{piece, hold != 0});
+                    }
+                }
+            }
+        }
+    }
+
+    // Best score reachable from a position with `remaining` more pieces
+    double Value(Game const& game, size_t remaining) const {
+        if (game.gameOver || remaining == 0) {
+            return Evaluate(game);
+        }
+        double lines = weights.w[BotWeights::Lines] * game.lastLinesCleared;
+
+        float stored;
+        uint8_t storedDepth = static_cast<uint8_t>(remaining);
+        if (table && table->Probe(TableKey(game), storedDepth, stored)) {
+            return lines + stored;
+        }
+
+        double best = -std::numeric_limits<double>::infinity();
+        ForEachPlacement(game, [&](Placement placement) {
+            Game after = game;
+            Apply(after, placement);
+            best = std::max(best, Value(after, remaining - 1));
+        });
+        if (table) {
+            // Round like a table hit would, so hits and misses agree
+            best = static_cast<float>(best);
+            table->Store(TableKey(game), storedDepth, static_cast<float>(best));
+        }
+        return lines + best;
+    }
+
+    Placement BestPlacement(Game const& game) const {
+        TRACE_SCOPE_VALUE("bot search", depth);
+        std::vector<Placement> placements;
+        ForEachPlacement(game, [&](Placement placement) {
+            placements.push_back(placement);
+        });
+
+        Placement best{game.currentPiece, false};
+        double bestScore = -std::numeric_limits<double>::infinity();
+        size_t bestIndex = placements.size();
+        std::mutex bestMutex;
+        if (table) {
+            table->NewSearch();
+        }
+        ParallelFor(placements.size(), threads, [&](size_t i, size_t) {
+            TRACE_SCOPE_VALUE("bot placement", i);
+            Game after = game;
+            Apply(after, placements[i]);
+            double score = Value(after, depth > 0 ? depth - 1 : 0);
+
+            // Ties go to the earliest placement so the result does not
+            // depend on thread timing
+            std::lock_guard lock{bestMutex};
+            if (score > bestScore || (score == bestScore && i < bestIndex)) {
+                bestScore = score;
+                bestIndex = i;
+                best = placements[i];
+            }
+            return true;
+        });
+        return best;
+    }
+
+    static void Apply(Game& game, Placement placement) {
+        if (placement.hold) {
+            game.SwapHold();
+        }
+        game.currentPiece = placement.piece;
+        game.HardDrop();
+    }
+
+    void Move(Game& game) const {
+        Apply(game, BestPlacement(game));
+    }
+};
@@ -3,9 +3,26 @@
 # CFLAGS="-std=c++20 -Wall -Wextra -Werror -Wno-c99-designator -fsanitize=undefined,address -ggdb"
 CFLAGS="-std=c++20 -I"SDL2/SDL2-2.32.4/include" -I"SDL2_ttf/SDL2_ttf-2.24.0/include" -L"SDL2/SDL2-2.32.4/lib/x64" -L"SDL2_ttf/SDL2_ttf-2.24.0/lib/x64" -Wall -Wextra -Werror -Wno-c99-designator -ggdb -lSDL2main -lSDL2 -lSDL2_ttf -lshell32 -Xlinker /SUBSYSTEM:CONSOLE"
 CC="clang++"
+# Add -DTETRIS_PROFILE to CFLAGS for the frame-phase profiler (F3 shows it, profile.csv on exit)
+# Add -DTETRIS_TRACE to CFLAGS for a Chrome trace of the session (trace.json on exit)
+# Headless tools only need the engine, not SDL
+TOOLFLAGS="-std=c++20 -O2 -Wall -Wextra -Werror -Wno-c99-designator"
 
 #Full Command: clang++ -std=c++20 -I"SDL2/SDL2-2.32.4/include" -I"SDL2_ttf/SDL2_ttf-2.24.0/include" -L"SDL2/SDL2-2.32.4/lib/x64" -L"SDL2_ttf/SDL2_ttf-2.24.0/lib/x64" -Wall -Wextra -Werror -Wno-c99-designator -ggdb -lSDL2main -lSDL2 -lSDL2_ttf -lshell32 -Xlinker /SUBSYSTEM:CONSOLE tetris.cpp -o tetris.exe
 
 set -xe
 
+# Assets are compiled into the game; regenerate them before building it
+$CC $TOOLFLAGS asset_pack.cpp -o asset_pack.exe
+./asset_pack.exe --header assets_embedded.hpp fonts/ARCADECLASSIC.TTF
 $CC $CFLAGS tetris.cpp -o tetris.exe
+$CC $TOOLFLAGS tournament.cpp -o tournament.exe
+$CC $TOOLFLAGS tuner.cpp -o tuner.exe
+$CC $TOOLFLAGS -shared tetris_env.cpp -o tetris_env.dll
+$CC $TOOLFLAGS exporter.cpp -o exporter.exe
+$CC $CFLAGS -O2 -DBENCH_SDL bench.cpp -o bench.exe
+$CC $CFLAGS -O2 grid.cpp -o grid.exe
+$CC $TOOLFLAGS render.cpp -o render.exe
+$CC $TOOLFLAGS perfect_clear.cpp -o perfect_clear.exe
+$CC $TOOLFLAGS finesse.cpp -o finesse.exe
+$CC $TOOLFLAGS fuzz.cpp -o fuzz.exe
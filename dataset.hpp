@@ -0,0 +1,420 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+// Columnar training-data files of (state, action, outcome) samples.
+//
+// Layout, all little-endian:
+//   header   "TTRSDSET", u16 version, u8 width, u8 height, u32 reserved
+//   chunks   per chunk, each column compressed on its own, one after another
+//   index    ChunkIndexEntry per chunk
+//   trailer  u64 index offset, u32 chunk count, "TIDX"
+//
+// Columns, per sample:
+//   Rows      height x u16 row bitmasks, bit x set = column x filled
+//   Pieces    u32, 3 bits each: current, hold, next DatasetQueue pieces
+//   Actions   u8, hold << 7 | rotation << 5 | column (piece x + 2)
+//   Outcomes  u8, lines cleared | game over << 3
+//   Rewards   i32, score gained
+//
+// Columns are byte-shuffled (byte 0 of every sample, then byte 1, ...) and
+// run-length encoded, which turns the empty upper rows into long zero runs.
+// Readers map the file and decode any chunk on its own through the index.
+
+static constexpr size_t DatasetQueue = 5;
+
+namespace DatasetColumn {
+    enum DatasetColumn : size_t {
+        Rows = 0, Pieces, Actions, Outcomes, Rewards, COUNT,
+    };
+}
+
+struct DatasetChunk {
+    size_t count = 0;
+    std::vector<uint16_t> rows;  // count * height
+    std::vector<uint32_t> pieces;
+    std::vector<uint8_t> actions;
+    std::vector<uint8_t> outcomes;
+    std::vector<int32_t> rewards;
+
+    void Clear() {
+        count = 0;
+        rows.clear();
+        pieces.clear();
+        actions.clear();
+        outcomes.clear();
+        rewards.clear();
+    }
+};
+
+struct DatasetHeader {
+    char magic[8];
+    uint16_t version;
+    uint8_t width;
+    uint8_t height;
+    uint32_t reserved;
+};
+
+struct DatasetIndexEntry {
+    uint64_t offset;
+    uint32_t count;
+    uint32_t sizes[DatasetColumn::COUNT];  // Compressed bytes per column
+};
+
+struct DatasetTrailer {
+    uint64_t indexOffset;
+    uint32_t chunkCount;
+    char magic[4];
+};
+
+static constexpr char DatasetMagic[8] = {'T', 'T', 'R', 'S', 'D', 'S', 'E', 'T'};
+static constexpr char DatasetIndexMagic[4] = {'T', 'I', 'D', 'X'};
+static constexpr uint16_t DatasetVersion = 1;
+
+
+inline uint32_t PackPieces(uint8_t current, uint8_t hold, const uint8_t* queue) {
+    uint32_t packed = (current & 7u) | (hold & 7u) << 3;
+    for (size_t i = 0; i < DatasetQueue; ++i) {
+        packed |= (queue[i] & 7u) << (6 + 3 * i);
+    }
+    return packed;
+}
+
+inline uint8_t PackAction(bool hold, int8_t rotation, int8_t px) {
+    return static_cast<uint8_t>(hold << 7 | (rotation & 3) << 5 | ((px + 2) & 31));
+}
+
+inline void UnpackAction(uint8_t action, bool& hold, int8_t& rotation, int8_t& px) {
+    hold = action >> 7;
+    rotation = static_cast<int8_t>(action >> 5 & 3);
+    px = static_cast<int8_t>((action & 31) - 2);
+}
+
+inline uint8_t PackOutcome(int linesCleared, bool gameOver) {
+    return static_cast<uint8_t>((linesCleared & 7) | gameOver << 3);
+}
+
+// 64-bit hash of a position, for removing duplicates
+inline uint64_t PositionHash(const uint16_t* rows, size_t height, uint32_t pieces) {
+    uint64_t hash = 0x9E3779B97F4A7C15ull ^ pieces;
+    for (size_t y = 0; y < height; ++y) {
+        hash = (hash ^ rows[y]) * 0xBF58476D1CE4E5B9ull;
+        hash ^= hash >> 31;
+    }
+    return hash;
+}
+
+
+inline void CompressColumn(const void* data, size_t count, size_t elementSize, std::vector<uint8_t>& out) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t size = count * elementSize;
+
+    std::vector<uint8_t> shuffled(size);
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t b = 0; b < elementSize; ++b) {
+            shuffled[b * count + i] = bytes[i * elementSize + b];
+        }
+    }
+
+    // Control byte c < 128: c+1 literal bytes follow
+    //                c >= 128: the next byte repeats c-125 times
+    size_t i = 0;
+    while (i < size) {
+        size_t run = 1;
+        while (i + run < size && run < 130 && shuffled[i + run] == shuffled[i]) {
+            ++run;
+        }
+        if (run >= 3) {
+            out.push_back(static_cast<uint8_t>(run + 125));
+            out.push_back(shuffled[i]);
+            i += run;
+            continue;
+        }
+
+        size_t start = i;
+        while (i < size && i - start < 128) {
+            if (i + 2 < size && shuffled[i] == shuffled[i+1] && shuffled[i] == shuffled[i+2]) {
+                break;
+            }
+            ++i;
+        }
+        out.push_back(static_cast<uint8_t>(i - start - 1));
+        out.insert(out.end(), shuffled.begin() + static_cast<ptrdiff_t>(start), shuffled.begin() + static_cast<ptrdiff_t>(i));
+    }
+}
+
+inline bool DecompressColumn(const uint8_t* in, size_t inSize, size_t count, size_t elementSize, void* data) {
+    size_t size = count * elementSize;
+    std::vector<uint8_t> shuffled;
+    shuffled.reserve(size);
+
+    size_t i = 0;
+    while (i < inSize) {
+        uint8_t control = in[i++];
+        if (control < 128) {
+            size_t length = control + 1u;
+            if (i + length > inSize) {
+                return false;
+            }
+            shuffled.insert(shuffled.end(), in + i, in + i + length);
+            i += length;
+        }
+        else {
+            if (i >= inSize) {
+                return false;
+            }
+            shuffled.insert(shuffled.end(), control - 125u, in[i++]);
+        }
+    }
+    if (shuffled.size() != size) {
+        return false;
+    }
+
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    for (size_t n = 0; n < count; ++n) {
+        for (size_t b = 0; b < elementSize; ++b) {
+            bytes[n * elementSize + b] = shuffled[b * count + n];
+        }
+    }
+    return true;
+}
+
+
+// Positions already written, in a fixed amount of memory. Buckets of four
+// full 64-bit hashes, picked by the hash; a full bucket overwrites one of its
+// slots. Memory never grows, at the price of forgetting: once the filter is
+// full, a position seen long enough ago can be written again. Two different
+// positions are only mistaken for each other if their 64-bit hashes collide,
+// so nearly nothing is dropped that should have been kept.
+struct PositionFilter {
+    static constexpr size_t Ways = 4;
+
+    std::unique_ptr<uint64_t[]> slots;
+    size_t bucketMask = 0;
+
+    explicit PositionFilter(size_t bytes = 64ull << 20) {
+        size_t buckets = 1;
+        while (buckets * 2 * Ways * sizeof(uint64_t) <= bytes) {
+            buckets *= 2;
+        }
+        slots = std::make_unique<uint64_t[]>(buckets * Ways);
+        bucketMask = buckets - 1;
+    }
+
+    // Records the hash; returns false if it was already there
+    bool Insert(uint64_t hash) {
+        hash |= hash == 0;  // 0 marks an empty slot
+        uint64_t* bucket = &slots[(hash & bucketMask) * Ways];
+        for (size_t i = 0; i < Ways; ++i) {
+            if (bucket[i] == hash) {
+                return false;
+            }
+            if (bucket[i] == 0) {
+                bucket[i] = hash;
+                return true;
+            }
+        }
+        bucket[hash >> 62] = hash;
+        return true;
+    }
+};
+
+// A chunk's columns, compressed and ready to append
+struct CompressedChunk {
+    uint32_t count = 0;
+    uint32_t sizes[DatasetColumn::COUNT] = {};
+    std::vector<uint8_t> bytes;
+};
+
+inline void CompressChunk(DatasetChunk const& chunk, uint8_t height, CompressedChunk& out) {
+    const void* columns[DatasetColumn::COUNT] = {
+        chunk.rows.data(), chunk.pieces.data(), chunk.actions.data(),
+        chunk.outcomes.data(), chunk.rewards.data(),
+    };
+    // A whole board is one element, so each row lines up across samples
+    size_t elementSizes[DatasetColumn::COUNT] = {
+        height * sizeof(uint16_t), sizeof(uint32_t), sizeof(uint8_t), sizeof(uint8_t), sizeof(int32_t),
+    };
+    out.count = static_cast<uint32_t>(chunk.count);
+    out.bytes.clear();
+    std::vector<uint8_t> compressed;
+    for (size_t c = 0; c < DatasetColumn::COUNT; ++c) {
+        compressed.clear();
+        CompressColumn(columns[c], chunk.count, elementSizes[c], compressed);
+        out.sizes[c] = static_cast<uint32_t>(compressed.size());
+        out.bytes.insert(out.bytes.end(), compressed.begin(), compressed.end());
+    }
+}
+
+// Add, TakeChunk and Append are meant to be called under the caller's lock
+// and CompressChunk outside it, so producers only serialise on copying
+// samples in and writing finished chunks out. Chunks land in the file in the
+// order they are appended; the index keeps track of where.
+struct DatasetWriter {
+    FILE* file = nullptr;
+    uint8_t height = 0;
+    size_t chunkSize = 0;
+    uint64_t offset = 0;
+    size_t duplicates = 0;
+    size_t written = 0;
+    DatasetChunk pending;
+    std::vector<DatasetIndexEntry> index;
+    PositionFilter seen;
+
+    explicit DatasetWriter(size_t filterBytes = 64ull << 20) : seen(filterBytes) {}
+    ~DatasetWriter() { Close(); }
+
+    bool Open(const char* path, uint8_t width, uint8_t height_, size_t chunkSize_) {
+        file = fopen(path, "wb");
+        if (!file) {
+            return false;
+        }
+        height = height_;
+        chunkSize = chunkSize_;
+        DatasetHeader header{};
+        memcpy(header.magic, DatasetMagic, sizeof(header.magic));
+        header.version = DatasetVersion;
+        header.width = width;
+        header.height = height;
+        offset = fwrite(&header, 1, sizeof(header), file);
+        return offset == sizeof(header);
+    }
+
+    // Returns false if the position was already written
+    bool Add(const uint16_t* rows, uint32_t pieces, uint8_t action, uint8_t outcome, int32_t reward) {
+        if (!seen.Insert(PositionHash(rows, height, pieces))) {
+            ++duplicates;
+            return false;
+        }
+        pending.rows.insert(pending.rows.end(), rows, rows + height);
+        pending.pieces.push_back(pieces);
+        pending.actions.push_back(action);
+        pending.outcomes.push_back(outcome);
+        pending.rewards.push_back(reward);
+        ++pending.count;
+        return true;
+    }
+
+    bool Full() const {
+        return pending.count >= chunkSize;
+    }
+
+    // Hands over the pending samples, leaving `chunk`'s buffers in their place
+    void TakeChunk(DatasetChunk& chunk) {
+        chunk.Clear();
+        std::swap(chunk, pending);
+    }
+
+    bool Append(CompressedChunk const& chunk) {
+        if (chunk.count == 0) {
+            return true;
+        }
+        DatasetIndexEntry entry{};
+        entry.offset = offset;
+        entry.count = chunk.count;
+        memcpy(entry.sizes, chunk.sizes, sizeof(entry.sizes));
+        bool ok = fwrite(chunk.bytes.data(), 1, chunk.bytes.size(), file) == chunk.bytes.size();
+        offset += chunk.bytes.size();
+        index.push_back(entry);
+        written += chunk.count;
+        return ok;
+    }
+
+    // All three steps at once, for a single thread
+    bool FlushChunk() {
+        DatasetChunk chunk;
+        CompressedChunk compressed;
+        TakeChunk(chunk);
+        CompressChunk(chunk, height, compressed);
+        return Append(compressed);
+    }
+
+    bool Close() {
+        if (!file) {
+            return true;
+        }
+        bool ok = FlushChunk();
+        DatasetTrailer trailer{};
+        trailer.indexOffset = offset;
+        trailer.chunkCount = static_cast<uint32_t>(index.size());
+        memcpy(trailer.magic, DatasetIndexMagic, sizeof(trailer.magic));
+        ok &= fwrite(index.data(), sizeof(index[0]), index.size(), file) == index.size();
+        ok &= fwrite(&trailer, sizeof(trailer), 1, file) == 1;
+        ok &= fclose(file) == 0;
+        file = nullptr;
+        return ok;
+    }
+};
+
+
+struct DatasetReader {
+    MappedFile file;
+    DatasetHeader header{};
+    size_t chunkCount = 0;
+    const uint8_t* index = nullptr;
+
+    bool Open(const char* path) {
+        if (!file.Open(path) || file.size < sizeof(DatasetHeader) + sizeof(DatasetTrailer)) {
+            return false;
+        }
+        memcpy(&header, file.data, sizeof(header));
+        DatasetTrailer trailer;
+        memcpy(&trailer, file.data + file.size - sizeof(trailer), sizeof(trailer));
+        if (memcmp(header.magic, DatasetMagic, sizeof(header.magic)) != 0 ||
+            header.version != DatasetVersion ||
+            memcmp(trailer.magic, DatasetIndexMagic, sizeof(trailer.magic)) != 0 ||
+            trailer.indexOffset + trailer.chunkCount * sizeof(DatasetIndexEntry) + sizeof(trailer) != file.size) {
+            return false;
+        }
+        chunkCount = trailer.chunkCount;
+        index = file.data + trailer.indexOffset;
+        return true;
+    }
+
+    DatasetIndexEntry Entry(size_t chunk) const {
+        DatasetIndexEntry entry;
+        memcpy(&entry, index + chunk * sizeof(entry), sizeof(entry));
+        return entry;
+    }
+
+    bool ReadChunk(size_t chunk, DatasetChunk& out) const {
+        if (chunk >= chunkCount) {
+            return false;
+        }
+        DatasetIndexEntry entry = Entry(chunk);
+        out.count = entry.count;
+        out.rows.resize(entry.count * size_t{header.height});
+        out.pieces.resize(entry.count);
+        out.actions.resize(entry.count);
+        out.outcomes.resize(entry.count);
+        out.rewards.resize(entry.count);
+
+        void* columns[DatasetColumn::COUNT] = {
+            out.rows.data(), out.pieces.data(), out.actions.data(), out.outcomes.data(), out.rewards.data(),
+        };
+        size_t counts[DatasetColumn::COUNT] = {
+            out.count, out.count, out.count, out.count, out.count,
+        };
+        size_t elementSizes[DatasetColumn::COUNT] = {
+            header.height * sizeof(uint16_t), sizeof(uint32_t), sizeof(uint8_t), sizeof(uint8_t), sizeof(int32_t),
+        };
+
+        uint64_t offset = entry.offset;
+        for (size_t c = 0; c < DatasetColumn::COUNT; ++c) {
+            if (offset + entry.sizes[c] > file.size ||
+                !DecompressColumn(file.data + offset, entry.sizes[c], counts[c], elementSizes[c], columns[c])) {
+                return false;
+            }
+            offset += entry.sizes[c];
+        }
+        return true;
+    }
+};
@@ -0,0 +1,217 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tetris.hpp"
+#include "bot.hpp"
+#include "dataset.hpp"
+#include "replay.hpp"
+#include "parallel.hpp"
+
+// Batch self-play into a columnar training-data file (see dataset.hpp).
+// Games run on every core; finished games are handed to a single writer that
+// drops repeated positions and compresses full chunks.
+//
+// --read FILE decodes every chunk of an existing file and prints a summary.
+// --replays DIR also saves every game as DIR/game-<index>.rpl for render.exe.
+
+
+struct Sample {
+    uint16_t rows[20];
+    uint32_t pieces;
+    uint8_t action;
+    uint8_t outcome;
+    int32_t reward;
+};
+
+void PlayGame(uint64_t seed, Bot<> const& bot, size_t pressure, size_t maxPieces, std::vector<Sample>& samples,
+              Replay& replay) {
+    Tetris<> game(seed);
+    replay.seed = seed;
+    replay.moves.clear();
+    std::minstd_rand holeRng(static_cast<uint32_t>(seed >> 32));
+    for (size_t pieces = 0; pieces < maxPieces && !game.gameOver; ++pieces) {
+        Sample sample;
+        for (int8_t y = 0; y < 20; ++y) {
+            uint16_t row = 0;
+            for (int8_t x = 0; x < 10; ++x) {
+                row |= static_cast<uint16_t>((game.board[y][x] != Tetris<>::Tetromino::Type::None) << x);
+            }
+            sample.rows[y] = row;
+        }
+        uint8_t queue[DatasetQueue];
+        for (size_t i = 0; i < DatasetQueue; ++i) {
+            queue[i] = game.pieceQueue[game.pieceQueueTop + i];
+        }
+        sample.pieces = PackPieces(game.currentPiece.type, game.holdType, queue);
+
+        Bot<>::Placement placement = bot.BestPlacement(game);
+        long scoreBefore = game.score;
+        Bot<>::Apply(game, placement);
+        sample.action = PackAction(placement.hold, placement.piece.rotation, placement.piece.px);
+        ReplayMove move{sample.action};
+        if (game.lastLinesCleared == 0 && (pieces + 1) % pressure == 0) {
+            move.garbage = static_cast<uint8_t>(holeRng() % 10);
+            game.AddGarbage(1, static_cast<int8_t>(move.garbage));
+        }
+        replay.moves.push_back(move);
+
+        sample.outcome = PackOutcome(game.lastLinesCleared, game.gameOver);
+        sample.reward = static_cast<int32_t>(game.score - scoreBefore);
+        samples.push_back(sample);
+    }
+}
+
+int ReadDataset(const char* path) {
+    DatasetReader reader;
+    if (!reader.Open(path)) {
+        fprintf(stderr, "Failed to open dataset %s\n", path);
+        return 1;
+    }
+    size_t samples = 0;
+    size_t lines[5] = {};
+    size_t gameOvers = 0;
+    DatasetChunk chunk;
+    for (size_t i = 0; i < reader.chunkCount; ++i) {
+        if (!reader.ReadChunk(i, chunk)) {
+            fprintf(stderr, "Chunk %zu is corrupt\n", i);
+            return 1;
+        }
+        samples += chunk.count;
+        for (uint8_t outcome : chunk.outcomes) {
+            ++lines[std::min(outcome & 7, 4)];
+            gameOvers += outcome >> 3 & 1;
+        }
+    }
+    printf("%s: %ux%u board, %zu chunks, %zu samples, %zu bytes (%.2f bytes/sample)\n",
+           path, reader.header.width, reader.header.height, reader.chunkCount, samples,
+           reader.file.size, static_cast<double>(reader.file.size) / static_cast<double>(std::max<size_t>(samples, 1)));
+    printf("clears: 1x %zu  2x %zu  3x %zu  4x %zu  game overs %zu\n", lines[1], lines[2], lines[3], lines[4], gameOvers);
+    return 0;
+}
+
+void Usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --out F        output file (default selfplay.ttd)\n"
+        "  --games N      self-play games (default 1000)\n"
+        "  --pieces N     piece cap per game (default 1000)\n"
+        "  --pressure N   one garbage line every N pieces (default 4)\n"
+        "  --chunk N      samples per chunk (default 65536)\n"
+        "  --weights W    bot weights height,lines,holes,bumpiness\n"
+        "  --threads N    worker threads (default: all cores)\n"
+        "  --seed N       base seed (default 1)\n"
+        "  --replays D    also save each game as a replay in directory D\n"
+        "  --dedup-mb N   memory for spotting repeated positions (default 256)\n"
+        "  --read F       decode an existing file and print a summary\n",
+        program);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* out = "selfplay.ttd";
+    size_t games = 1000;
+    size_t maxPieces = 1000;
+    size_t pressure = 4;
+    size_t chunkSize = 65536;
+    size_t threads = DefaultThreadCount();
+    uint64_t seed = 1;
+    const char* replayDir = nullptr;
+    size_t dedupMegabytes = 256;
+    Bot<> bot;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i+1 < argc ? argv[++i] : nullptr;
+        if (!value) {
+            Usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "--read") == 0) return ReadDataset(value);
+        else if (strcmp(arg, "--out") == 0) out = value;
+        else if (strcmp(arg, "--games") == 0) games = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--pieces") == 0) maxPieces = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--pressure") == 0) pressure = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--chunk") == 0) chunkSize = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--weights") == 0 && BotWeights::Parse(value, bot.weights)) {}
+        else if (strcmp(arg, "--threads") == 0) threads = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--seed") == 0) seed = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--replays") == 0) replayDir = value;
+        else if (strcmp(arg, "--dedup-mb") == 0) dedupMegabytes = std::max(1ull, strtoull(value, nullptr, 10));
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    DatasetWriter writer(dedupMegabytes << 20);
+    if (!writer.Open(out, 10, 20, chunkSize)) {
+        fprintf(stderr, "Failed to create %s\n", out);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::mutex writerMutex;
+    std::vector<std::vector<Sample>> buffers(threads);
+    std::vector<Replay> replays(threads);
+    std::vector<DatasetChunk> chunks(threads);
+    std::vector<CompressedChunk> compressed(threads);
+    std::atomic<bool> replayFailed{false};
+    std::atomic<bool> writeFailed{false};
+    ParallelFor(games, threads, [&](size_t index, size_t worker) {
+        std::vector<Sample>& samples = buffers[worker];
+        samples.clear();
+        PlayGame(DeriveSeed(seed, index), bot, pressure, maxPieces, samples, replays[worker]);
+        if (replayDir) {
+            std::string path = std::string(replayDir) + "/game-" + std::to_string(index) + ".rpl";
+            if (!replays[worker].Save(path.c_str()) && !replayFailed.exchange(true)) {
+                fprintf(stderr, "Failed to write %s\n", path.c_str());
+            }
+        }
+
+        // Chunks that fill up are compressed outside the lock, so other
+        // workers can keep adding samples meanwhile
+        for (size_t next = 0; next < samples.size();) {
+            {
+                std::lock_guard lock{writerMutex};
+                for (; next < samples.size() && !writer.Full(); ++next) {
+                    Sample const& sample = samples[next];
+                    writer.Add(sample.rows, sample.pieces, sample.action, sample.outcome, sample.reward);
+                }
+                if (!writer.Full()) {
+                    break;
+                }
+                writer.TakeChunk(chunks[worker]);
+            }
+            CompressChunk(chunks[worker], 20, compressed[worker]);
+            std::lock_guard lock{writerMutex};
+            if (!writer.Append(compressed[worker]) && !writeFailed.exchange(true)) {
+                fprintf(stderr, "Failed to write %s\n", out);
+            }
+        }
+        return true;
+    });
+    size_t written = writer.written + writer.pending.count;
+    size_t duplicates = writer.duplicates;
+    if (!writer.Close() || writeFailed) {
+        fprintf(stderr, "Failed to write %s\n", out);
+        return 1;
+    }
+
+    if (replayFailed) {
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%zu samples (%zu duplicates dropped) from %zu games in %.1fs\n", written, duplicates, games, seconds);
+    return ReadDataset(out);
+}
@@ -0,0 +1,213 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "tetris.hpp"
+#include "bot.hpp"
+#include "replay.hpp"
+#include "finesse.hpp"
+
+// Turns the placements of saved replays into key presses (see finesse.hpp)
+// and reports how many inputs they take and how often the cached empty-board
+// paths could be used.
+//
+// --table prints the cached paths. --verify plays every move's keys through
+// Tetris::Update on a simulated clock and checks that each piece lands where
+// the replay put it.
+
+using Paths = Finesse<>;
+
+static constexpr char PieceNames[] = ".IJLOSTZG";
+
+static void PrintPath(InputPath const& path) {
+    for (size_t i = 0; i < path.length; ++i) {
+        printf("%s%s", i ? ", " : "", Describe(path.inputs[i]));
+    }
+}
+
+static void PrintTable() {
+    Paths::Table const& table = Paths::Paths();
+    for (size_t type = Tetris<>::Tetromino::Type::I; type <= Tetris<>::Tetromino::Type::Z; ++type) {
+        for (int8_t rotation = 0; rotation < 4; ++rotation) {
+            for (int8_t px = 0; px < 10; ++px) {
+                InputPath const& path = table[type][rotation][px];
+                if (path.length == 0) {
+                    continue;
+                }
+                printf("%c rotation %d column %d: ", PieceNames[type], rotation, px);
+                PrintPath(path);
+                printf("\n");
+            }
+        }
+    }
+}
+
+// Feeds the path's key events to Update, one update per ARR, until the update
+// that drops the piece. `now` is the update the piece spawned on, and is left
+// on the one that spawns the next.
+static void PlayKeys(Tetris<>& game, Tetris<>::Tetromino::Type type, InputPath const& path, timepoint& now) {
+    std::vector<InputEvent> events;
+    timepoint start = now + Tetris<>::ARR;
+    timepoint drop = Paths::Schedule(game, type, path, start, events);
+    size_t next = 0;
+    for (now = start; now <= drop; now += Tetris<>::ARR) {
+        while (next < events.size() && events[next].time <= now) {
+            inputQueue.Push(events[next++]);
+        }
+        ApplyInput();
+        game.Update(now);
+    }
+    now = drop;
+    // Space's release, seen on the next piece's first update
+    while (next < events.size()) {
+        inputQueue.Push(events[next++]);
+    }
+}
+
+struct Stats {
+    size_t moves = 0;
+    size_t cached = 0;
+    size_t searched = 0;
+    size_t unreachable = 0;
+    size_t inputs = 0;
+    size_t verified = 0;
+    size_t mismatched = 0;
+    double lookupSeconds = 0;
+    double searchSeconds = 0;
+};
+
+// `now` is the simulated clock; it only runs forwards, as Update expects
+static bool Analyse(const char* path, bool printKeys, bool verify, timepoint& now, Stats& stats) {
+    Replay replay;
+    if (!replay.Load(path)) {
+        return false;
+    }
+    using clock = std::chrono::steady_clock;
+    Tetris<> game(replay.seed);
+    Tetris<> played(replay.seed);
+    for (size_t i = 0; i < replay.moves.size() && !game.gameOver; ++i) {
+        Bot<>::Placement placement = Replay::Decode(game, replay.moves[i]);
+        InputPath keys;
+
+        auto start = clock::now();
+        bool cached = Paths::Cached(game, placement, keys);
+        stats.lookupSeconds += std::chrono::duration<double>(clock::now() - start).count();
+        start = clock::now();
+        InputPath searched;
+        Tetris<>::Tetromino target = placement.piece;
+        target.py += game.DistanceFromFloor(target);
+        bool found = Paths::Search(game, target, placement.hold, searched);
+        stats.searchSeconds += std::chrono::duration<double>(clock::now() - start).count();
+
+        ++stats.moves;
+        if (cached) {
+            ++stats.cached;
+        }
+        else if (found) {
+            ++stats.searched;
+            keys = searched;
+        }
+        else {
+            ++stats.unreachable;
+        }
+        if (cached || found) {
+            stats.inputs += keys.length;
+        }
+        if (printKeys) {
+            printf("%s move %zu: %c rotation %d column %d%s: ", path, i, PieceNames[placement.piece.type],
+                   placement.piece.rotation, placement.piece.px, placement.hold ? " after hold" : "");
+            PrintPath(keys);
+            printf("%s\n", cached ? "" : found ? " (searched)" : "unreachable");
+        }
+
+        Bot<>::Apply(game, placement);
+        if (verify && (cached || found)) {
+            PlayKeys(played, placement.piece.type, keys, now);
+            ++stats.verified;
+            if (played.hash != game.hash) {
+                ++stats.mismatched;
+                fprintf(stderr, "%s move %zu: the keys did not land where the replay did\n", path, i);
+                played = game;
+            }
+        }
+        if (replay.moves[i].garbage != ReplayNoGarbage) {
+            game.AddGarbage(1, static_cast<int8_t>(replay.moves[i].garbage));
+            played.AddGarbage(1, static_cast<int8_t>(replay.moves[i].garbage));
+        }
+    }
+    return true;
+}
+
+
+void Usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options] REPLAY...\n"
+        "  --table        print the cached empty-board paths\n"
+        "  --keys         print every move's keys\n"
+        "  --verify       play the keys through the game and check where pieces land\n",
+        program);
+}
+
+int main(int argc, char* argv[])
+{
+    bool table = false;
+    bool printKeys = false;
+    bool verify = false;
+    std::vector<const char*> replays;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--table") == 0) table = true;
+        else if (strcmp(arg, "--keys") == 0) printKeys = true;
+        else if (strcmp(arg, "--verify") == 0) verify = true;
+        else if (strncmp(arg, "--", 2) != 0) replays.push_back(arg);
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!table && replays.empty()) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Paths::Paths();
+    double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (table) {
+        PrintTable();
+        printf("Built in %.2f ms\n", buildSeconds * 1e3);
+    }
+
+    Stats stats;
+    timepoint now = std::chrono::system_clock::now().time_since_epoch().count();
+    if (verify) {
+        // Start the clock on an update that restarts the fall timer, as every
+        // hard drop after it does
+        Tetris<> start(0);
+        start.Update(now);
+    }
+    for (const char* path : replays) {
+        if (!Analyse(path, printKeys, verify, now, stats)) {
+            fprintf(stderr, "Failed to read %s\n", path);
+            return 1;
+        }
+    }
+    if (stats.moves == 0) {
+        return 0;
+    }
+    double moves = static_cast<double>(stats.moves);
+    printf("%zu moves: %zu from the table, %zu searched, %zu unreachable; %.2f inputs per piece\n",
+           stats.moves, stats.cached, stats.searched, stats.unreachable,
+           static_cast<double>(stats.inputs) / static_cast<double>(std::max<size_t>(stats.moves - stats.unreachable, 1)));
+    printf("table lookup %.0f ns per move, search %.0f ns per move\n",
+           stats.lookupSeconds * 1e9 / moves, stats.searchSeconds * 1e9 / moves);
+    if (verify) {
+        printf("%zu moves played through Update, %zu landed elsewhere\n", stats.verified, stats.mismatched);
+    }
+    return stats.mismatched ? 1 : 0;
+}
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <vector>
+
+#include "tetris.hpp"
+#include "bot.hpp"
+
+// Fewest key presses that put a piece where a placement wants it, so a bot's
+// moves can be played back as real input.
+//
+// Inputs follow what Update does with each key: a tap of Left or Right moves
+// one column, holding it moves to the wall once DAS has charged (then one
+// column per ARR), Up and z rotate with kicks, holding Down soft drops to the
+// floor and Space hard drops. Holding a key counts as one input, as finesse
+// is usually counted.
+//
+// Every input is played update by update, one update per ARR from the one
+// that spawned the piece, so gravity and lock delay act on the piece while
+// keys are held or between them, just as they do in Update. A hard drop
+// restarts the fall timer, so the update a piece spawns on fixes when it
+// falls. Schedule turns a path into key events with the same timing.
+//
+// Paths from the spawn position on an empty board are searched once, on first
+// use, for every (type, rotation, column). A cached path is used whenever
+// replaying it on the actual board lands in the same place, which is nearly
+// always true while the spawn rows are clear. Otherwise a breadth-first
+// search over the real board finds the path, tucks and spins included.
+
+// One key of an input path: tapped, or held until the piece stops moving
+struct KeyInput {
+    KeyPress::KeyPress key;
+    bool held;
+};
+
+struct InputPath {
+    static constexpr size_t Capacity = 32;
+
+    uint8_t length = 0;
+    KeyInput inputs[Capacity];
+
+    bool Push(KeyInput input) {
+        if (length == Capacity) {
+            return false;
+        }
+        inputs[length++] = input;
+        return true;
+    }
+};
+
+inline const char* Describe(KeyInput input) {
+    switch (input.key) {
+        case KeyPress::Left:  return input.held ? "Left DAS" : "Left";
+        case KeyPress::Right: return input.held ? "Right DAS" : "Right";
+        case KeyPress::Up:    return "Up";
+        case KeyPress::z:     return "z";
+        case KeyPress::Down:  return "Down held";
+        case KeyPress::Space: return "Space";
+        case KeyPress::c:     return "c";
+        default:              return "?";
+    }
+}
+
+
+template<int8_t Width=10, int8_t Height=20>
+struct Finesse {
+    using Game = Tetris<Width, Height>;
+    using Tetromino = typename Game::Tetromino;
+    using Placement = typename Bot<Width, Height>::Placement;
+
+    // Every input but Space, which ends a path, in the order the search tries them
+    static constexpr KeyInput Moves[] = {
+        {KeyPress::Left, false}, {KeyPress::Right, false},
+        {KeyPress::Left, true}, {KeyPress::Right, true},
+        {KeyPress::Up, false}, {KeyPress::z, false},
+        {KeyPress::Down, true},
+    };
+
+    // The piece between inputs. Updates are counted from the one that
+    // spawned the piece, one per ARR.
+    struct State {
+        Tetromino piece;
+        int update = 1;    // Next update; the next key is pressed on it
+        int fell = 0;      // Last update gravity ran
+        int moved = 0;     // Last update the piece changed position
+        KeyPress::KeyPress last = KeyPress::Space;  // Released on `update`
+    };
+
+    // Gravity and lock delay for one update; false if the piece locked
+    static bool Fall(Game const& game, State& state, int update) {
+        if ((update - state.fell) * Game::ARR >= game.FallInterval()) {
+            state.fell = update;
+            if (!game.PieceHitWall(state.piece, 0, 1)) {
+                ++state.piece.py;
+                state.moved = update;
+            }
+        }
+        return !game.PieceHitWall(state.piece, 0, 1) || (update - state.moved) * Game::ARR < Game::LOCK_DELAY;
+    }
+
+    // Plays one input the way Update does: pressed on the next update (one
+    // later if the same key has to be seen released first) and released as
+    // soon as it can do no more. `type` is the piece a hold swaps in.
+    // `pressed` gets the update the key went down on. False if the piece
+    // locks first.
+    static bool Apply(Game const& game, State& state, KeyInput input, typename Tetromino::Type type, int* pressed = nullptr) {
+        Tetromino& piece = state.piece;
+        int press = state.update + (input.key == state.last ? 1 : 0);
+        int update = state.update;
+        for (; update < press; ++update) {
+            if (!Fall(game, state, update)) {
+                return false;
+            }
+        }
+        if (pressed) {
+            *pressed = press;
+        }
+
+        switch (input.key) {
+            case KeyPress::Left:
+            case KeyPress::Right: {
+                // One column on the press, then one per update once DAS has charged
+                int8_t dx = input.key == KeyPress::Right ? 1 : -1;
+                for (;; ++update) {
+                    if (!Fall(game, state, update)) {
+                        return false;
+                    }
+                    bool repeat = input.held && (update - press) * Game::ARR > Game::DAS;
+                    if (update != press && !repeat) {
+                        continue;
+                    }
+                    bool blocked = game.PieceHitWall(piece, dx, 0);
+                    if (!blocked) {
+                        piece.px += dx;
+                        state.moved = update;
+                    }
+                    if (!input.held || (repeat && blocked)) {
+                        break;
+                    }
+                }
+                break;
+            }
+            case KeyPress::Up:
+            case KeyPress::z: {
+                if (!Fall(game, state, update)) {
+                    return false;
+                }
+                Tetromino before = piece;
+                game.Rotate(piece, input.key == KeyPress::Up);
+                if (piece.px != before.px || piece.py != before.py) {
+                    state.moved = update;
+                }
+                break;
+            }
+            case KeyPress::Down:
+                for (;; ++update) {
+                    if (!Fall(game, state, update)) {
+                        return false;
+                    }
+                    if (game.PieceHitWall(piece, 0, 1)) {
+                        break;
+                    }
+                    ++piece.py;
+                    state.moved = update;
+                }
+                break;
+            case KeyPress::c:
+                if (!Fall(game, state, update)) {
+                    return false;
+                }
+                piece = Tetromino{type};
+                state.moved = update;
+                break;
+            case KeyPress::Space:
+                if (!Fall(game, state, update)) {
+                    return false;
+                }
+                piece.py += game.DistanceFromFloor(piece);
+                break;
+            default:
+                break;
+        }
+        state.update = update + 1;
+        state.last = input.key;
+        return true;
+    }
+
+    // Same cells, whichever rotation state covers them (O, and pairs of I, S and Z)
+    static bool SameCells(Tetromino a, Tetromino b) {
+        if (a.type != b.type || a.px < 0 || a.px >= Width || b.px < 0 || b.px >= Width) {
+            return false;
+        }
+        typename Game::PieceMask const& maskA = Game::PieceMasks[a.type][a.rotation][a.px];
+        typename Game::PieceMask const& maskB = Game::PieceMasks[b.type][b.rotation][b.px];
+        if (maskA.outside || maskB.outside || maskA.rows != maskB.rows || a.py + maskA.top != b.py + maskB.top) {
+            return false;
+        }
+        for (int8_t r = 0; r < maskA.rows; ++r) {
+            if (maskA.row[r] != maskB.row[r]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Fewest inputs from the spawn position to the piece resting at `target`,
+    // breadth first over (column, row, rotation) on the actual board. With
+    // `hold` the path starts by swapping the target's type in.
+    static bool Search(Game const& game, Tetromino target, bool hold, InputPath& path) {
+        static constexpr int Margin = 3;  // Kicks and wide pieces reach past the edges
+        static constexpr int Columns = Width + 2 * Margin;
+        static constexpr int Rows = Height + 2 * Margin;
+        auto Index = [](Tetromino piece) -> int {
+            int x = piece.px + Margin;
+            int y = piece.py + Margin;
+            if (x < 0 || x >= Columns || y < 0 || y >= Rows) {
+                return -1;
+            }
+            return (y * Columns + x) * 4 + piece.rotation;
+        };
+
+        State start{Tetromino{target.type}};
+        if (game.PieceHitWall(start.piece)) {
+            return false;
+        }
+        if (hold && (!path.Push({KeyPress::c, false}) || !Apply(game, start, {KeyPress::c, false}, target.type))) {
+            return false;
+        }
+        std::vector<int16_t> parent(Columns * Rows * 4, -1);
+        std::vector<uint8_t> how(Columns * Rows * 4);
+        std::vector<State> queue{start};
+        parent[Index(start.piece)] = static_cast<int16_t>(Index(start.piece));
+
+        for (size_t head = 0; head < queue.size(); ++head) {
+            State state = queue[head];
+            State dropped = state;
+            if (Apply(game, dropped, {KeyPress::Space, false}, target.type) && SameCells(dropped.piece, target)) {
+                KeyInput reversed[InputPath::Capacity];
+                size_t count = 0;
+                for (int i = Index(state.piece); i != parent[i] && count < InputPath::Capacity; i = parent[i]) {
+                    reversed[count++] = Moves[how[i]];
+                }
+                while (count > 0) {
+                    path.Push(reversed[--count]);
+                }
+                return path.Push({KeyPress::Space, false});
+            }
+            for (uint8_t m = 0; m < std::size(Moves); ++m) {
+                State next = state;
+                if (!Apply(game, next, Moves[m], target.type)) {
+                    continue;
+                }
+                int index = Index(next.piece);
+                if (index < 0 || parent[index] >= 0) {
+                    continue;
+                }
+                parent[index] = static_cast<int16_t>(Index(state.piece));
+                how[index] = m;
+                queue.push_back(next);
+            }
+        }
+        return false;
+    }
+
+    // Table[type][rotation][column], for an empty board; length 0 where the
+    // piece does not fit
+    using Table = std::array<std::array<std::array<InputPath, Width>, 4>, Tetromino::Type::Z + 1>;
+
+    static Table const& Paths() {
+        static const Table table = [] {
+            Table paths{};
+            Game empty(0);
+            for (size_t type = Tetromino::Type::I; type <= Tetromino::Type::Z; ++type) {
+                for (int8_t rotation = 0; rotation < 4; ++rotation) {
+                    for (int8_t px = 0; px < Width; ++px) {
+                        Tetromino target{static_cast<typename Tetromino::Type>(type)};
+                        target.rotation = rotation;
+                        target.px = px;
+                        if (empty.PieceHitWall(target)) {
+                            continue;
+                        }
+                        target.py += empty.DistanceFromFloor(target);
+                        Search(empty, target, false, paths[type][rotation][px]);
+                    }
+                }
+            }
+            return paths;
+        }();
+        return table;
+    }
+
+    // Where a whole path, Space included, drops a piece of `type` on this board
+    static bool Follow(Game const& game, typename Tetromino::Type type, InputPath const& path, Tetromino& landed) {
+        State state{Tetromino{type}};
+        if (game.PieceHitWall(state.piece)) {
+            return false;
+        }
+        for (size_t i = 0; i < path.length; ++i) {
+            if (!Apply(game, state, path.inputs[i], type)) {
+                return false;
+            }
+        }
+        landed = state.piece;
+        return true;
+    }
+
+    // The cached empty-board path, if it still works on this board
+    static bool Cached(Game const& game, Placement placement, InputPath& path) {
+        Tetromino target = placement.piece;
+        if (target.px < 0 || target.px >= Width) {
+            return false;
+        }
+        InputPath const& cached = Paths()[target.type][target.rotation][target.px];
+        if (cached.length == 0) {
+            return false;
+        }
+        path.length = 0;
+        if (placement.hold) {
+            path.Push({KeyPress::c, false});
+        }
+        for (size_t i = 0; i < cached.length; ++i) {
+            path.Push(cached.inputs[i]);
+        }
+        Tetromino landed;
+        target.py += game.DistanceFromFloor(target);
+        return Follow(game, target.type, path, landed) && SameCells(landed, target);
+    }
+
+    // Inputs that make the placement the way Bot::Apply would: the piece hard
+    // dropped from where placement.piece is. False if no inputs can get it there.
+    static bool Path(Game const& game, Placement placement, InputPath& path) {
+        if (Cached(game, placement, path)) {
+            return true;
+        }
+        Tetromino target = placement.piece;
+        target.py += game.DistanceFromFloor(target);
+        path.length = 0;
+        return Search(game, target, placement.hold, path);
+    }
+
+    // Timed key events that play a path through Update with the timing Apply
+    // models: `start` is the first update after the piece of `type` spawned
+    // and updates follow every ARR. Returns when Space goes down; its release
+    // is the last event, on the next piece's first update.
+    static timepoint Schedule(Game const& game, typename Tetromino::Type type, InputPath const& path,
+                              timepoint start, std::vector<InputEvent>& events) {
+        State state{Tetromino{type}};
+        timepoint drop = start;
+        for (size_t i = 0; i < path.length; ++i) {
+            KeyInput input = path.inputs[i];
+            int press = state.update;
+            bool played = Apply(game, state, input, type, &press);
+            drop = start + (press - 1) * Game::ARR;
+            events.push_back({drop, input.key, true});
+            int release = played ? state.update : press + 1;
+            events.push_back({start + (release - 1) * Game::ARR, input.key, false});
+            if (!played) {
+                break;
+            }
+        }
+        return drop;
+    }
+};
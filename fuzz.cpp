@@ -0,0 +1,441 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "tetris.hpp"
+#include "reference.hpp"
+#include "parallel.hpp"
+
+// Differential fuzzer: random seeded streams of actions (moves, rotations,
+// soft and hard drops, hold, garbage) are applied to the engine and to the
+// plain model in reference.hpp in lockstep, on every core, and the two are
+// compared after each action. The first stream that makes them disagree is
+// cut down to a short sequence that still does, and written to a repro file
+// that --repro replays.
+//
+// Each stream is reproducible from --seed and its index alone, so a run can
+// be repeated exactly.
+
+enum Action : uint8_t {
+    Left, Right, RotateCW, RotateCCW, SoftDrop, HardDrop, Hold, Garbage, ActionCount,
+};
+
+static constexpr const char* ActionNames[ActionCount] = {
+    "left", "right", "cw", "ccw", "down", "drop", "hold", "garbage",
+};
+
+// One byte per action: the Action in the low 3 bits, the garbage hole above
+using Actions = std::vector<uint8_t>;
+
+// Weighted towards moves and rotations, which is where the state space is;
+// garbage rarely, as in a real game
+static uint8_t RandomAction(uint64_t& state, int8_t width) {
+    static constexpr uint8_t Weights[ActionCount] = {12, 12, 9, 6, 10, 8, 4, 3};  // Out of 64
+    uint64_t bits = SplitMix64(state);
+    uint8_t roll = bits & 63;
+    uint8_t action = 0;
+    while (roll >= Weights[action]) {
+        roll -= Weights[action++];
+    }
+    if (action == Garbage) {
+        action |= static_cast<uint8_t>((bits >> 8) % static_cast<uint64_t>(width) << 3);
+    }
+    return action;
+}
+
+// The engine and the reference side by side, always fed the same actions
+template<int8_t Width, int8_t Height>
+struct Lockstep {
+    Tetris<Width, Height> game;
+    ReferenceTetris<Width, Height> reference;
+
+    explicit Lockstep(uint64_t seed) : game(seed), reference(seed) {}
+
+    // Applies one action to both. Returns whether the board, hold or queue
+    // may have changed, so Difference has to compare them too.
+    bool Apply(uint8_t action) {
+        bool changed = false;
+        if (game.gameOver) {
+            game.ResetGame();
+            reference.ResetGame();
+            changed = true;
+        }
+        auto Move = [](auto& model, int8_t dx, int8_t dy) {
+            if (!model.PieceHitWall(model.currentPiece, dx, dy)) {
+                model.currentPiece.px += dx;
+                model.currentPiece.py += dy;
+            }
+        };
+        switch (action & 7) {
+            case Left:      Move(game, -1, 0); Move(reference, -1, 0); break;
+            case Right:     Move(game, 1, 0); Move(reference, 1, 0); break;
+            case SoftDrop:  Move(game, 0, 1); Move(reference, 0, 1); break;
+            case RotateCW:  game.Rotate(game.currentPiece, true); reference.Rotate(reference.currentPiece, true); break;
+            case RotateCCW: game.Rotate(game.currentPiece, false); reference.Rotate(reference.currentPiece, false); break;
+            case HardDrop:  game.HardDrop(); reference.HardDrop(); return true;
+            case Hold:      game.SwapHold(); reference.SwapHold(); return true;
+            case Garbage: {
+                int8_t hole = static_cast<int8_t>(action >> 3);
+                game.AddGarbage(1, hole);
+                reference.AddGarbage(1, hole);
+                return true;
+            }
+        }
+        return changed;
+    }
+
+    // What the two disagree on, or nullptr. The board and everything derived
+    // from it are only compared when `everything` is set.
+    const char* Difference(bool everything) const {
+        using Tetromino = typename Tetris<Width, Height>::Tetromino;
+        Tetromino const& a = game.currentPiece;
+        Tetromino const& b = reference.currentPiece;
+        if (game.gameOver != reference.gameOver) {
+            return "game over";
+        }
+        if (a.type != b.type || a.rotation != b.rotation || a.px != b.px || a.py != b.py) {
+            return "piece in play";
+        }
+        if (!game.gameOver && game.DistanceFromFloor(a) != reference.DistanceFromFloor(b)) {
+            return "distance from floor";
+        }
+        if (!everything) {
+            return nullptr;
+        }
+        if (game.holdType != reference.holdType || game.alreadySwapped != reference.alreadySwapped) {
+            return "hold";
+        }
+        if (game.pieceQueueTop != reference.pieceQueueTop ||
+            memcmp(game.pieceQueue, reference.pieceQueue, sizeof(game.pieceQueue)) != 0) {
+            return "piece queue";
+        }
+        if (memcmp(game.board, reference.board, sizeof(game.board)) != 0) {
+            return "board";
+        }
+        if (game.score != reference.score || game.linesCleared != reference.linesCleared ||
+            game.level != reference.level || game.lastLinesCleared != reference.lastLinesCleared) {
+            return "score";
+        }
+        for (int8_t y = 0; y < Height; ++y) {
+            typename Tetris<Width, Height>::Row bits = 0;
+            for (int8_t x = 0; x < Width; ++x) {
+                bits |= static_cast<decltype(bits)>(static_cast<decltype(bits)>(reference.Filled(x, y)) << x);
+            }
+            if (game.rowBits[y] != bits) {
+                return "row masks";
+            }
+        }
+        for (int8_t x = 0; x < Width; ++x) {
+            int8_t top = 0;
+            while (top < Height && !reference.Filled(x, top)) {
+                ++top;
+            }
+            if (game.columnTop[x] != top) {
+                return "column tops";
+            }
+        }
+        if (game.hash != reference.Hash()) {
+            return "hash";
+        }
+        return nullptr;
+    }
+};
+
+struct Divergence {
+    size_t step;  // Actions applied when they disagreed, 0 if from the start
+    const char* what;
+};
+
+// Plays `actions` in lockstep; `step` is actions.size() if nothing diverged
+template<int8_t Width, int8_t Height>
+static Divergence FirstDivergence(uint64_t seed, Actions const& actions) {
+    Lockstep<Width, Height> lockstep(seed);
+    if (const char* what = lockstep.Difference(true)) {
+        return {0, what};
+    }
+    for (size_t i = 0; i < actions.size(); ++i) {
+        if (const char* what = lockstep.Difference(lockstep.Apply(actions[i]))) {
+            return {i + 1, what};
+        }
+    }
+    return {actions.size(), nullptr};
+}
+
+// Cuts the actions after the divergence, then tries removing ever smaller
+// chunks, keeping every removal that still diverges. Greedy rather than a
+// full delta debugging run, but bugs in the rules tend to need only a few
+// pieces.
+template<int8_t Width, int8_t Height>
+static Actions Minimise(uint64_t seed, Actions actions) {
+    auto Diverges = [&](Actions& candidate) {
+        Divergence divergence = FirstDivergence<Width, Height>(seed, candidate);
+        if (!divergence.what) {
+            return false;
+        }
+        candidate.resize(divergence.step);
+        return true;
+    };
+    Diverges(actions);
+    for (size_t chunk = std::max<size_t>(actions.size() / 2, 1); chunk > 0; chunk /= 2) {
+        for (size_t start = 0; start < actions.size();) {
+            Actions candidate(actions.begin(), actions.begin() + static_cast<ptrdiff_t>(start));
+            candidate.insert(candidate.end(), actions.begin() + static_cast<ptrdiff_t>(std::min(start + chunk, actions.size())), actions.end());
+            if (Diverges(candidate)) {
+                actions = std::move(candidate);
+            }
+            else {
+                start += chunk;
+            }
+        }
+    }
+    return actions;
+}
+
+static bool WriteRepro(const char* path, int8_t width, int8_t height, uint64_t seed, Actions const& actions, Divergence divergence) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+    fprintf(file, "# %s differs after %zu actions\n", divergence.what, divergence.step);
+    fprintf(file, "board %dx%d\n", width, height);
+    fprintf(file, "seed %llu\n", static_cast<unsigned long long>(seed));
+    for (uint8_t action : actions) {
+        if ((action & 7) == Garbage) {
+            fprintf(file, "%s %d\n", ActionNames[Garbage], action >> 3);
+        }
+        else {
+            fprintf(file, "%s\n", ActionNames[action & 7]);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+struct Repro {
+    int width = 10;
+    int height = 20;
+    uint64_t seed = 0;
+    Actions actions;
+
+    bool Load(const char* path) {
+        FILE* file = fopen(path, "r");
+        if (!file) {
+            return false;
+        }
+        bool ok = true;
+        char line[128];
+        while (ok && fgets(line, sizeof(line), file)) {
+            char name[32];
+            int value = 0;
+            unsigned long long number = 0;
+            if (line[0] == '#' || line[0] == '\n') {
+                continue;
+            }
+            if (sscanf(line, "board %dx%d", &width, &height) == 2) {
+                continue;
+            }
+            if (sscanf(line, "seed %llu", &number) == 1) {
+                seed = number;
+                continue;
+            }
+            ok = sscanf(line, "%31s %d", name, &value) >= 1;
+            uint8_t action = 0;
+            while (ok && action < ActionCount && strcmp(name, ActionNames[action]) != 0) {
+                ++action;
+            }
+            ok = ok && action < ActionCount && value >= 0 && value < width;
+            actions.push_back(static_cast<uint8_t>(action | (action == Garbage ? value << 3 : 0)));
+        }
+        fclose(file);
+        return ok;
+    }
+};
+
+template<int8_t Width, int8_t Height>
+static void PrintBoards(Lockstep<Width, Height> const& lockstep) {
+    static constexpr char Names[] = ".IJLOSTZG";
+    printf("  engine%*s reference\n", Width - 5, "");
+    for (int8_t y = 0; y < Height; ++y) {
+        printf("  ");
+        for (int8_t x = 0; x < Width; ++x) {
+            putchar(Names[lockstep.game.board[y][x]]);
+        }
+        printf("   ");
+        for (int8_t x = 0; x < Width; ++x) {
+            putchar(Names[lockstep.reference.board[y][x]]);
+        }
+        printf("\n");
+    }
+    auto PrintPiece = [](const char* label, auto const& piece) {
+        printf("  %s: %c rotation %d at (%d, %d)\n", label, Names[piece.type], piece.rotation, piece.px, piece.py);
+    };
+    PrintPiece("engine piece", lockstep.game.currentPiece);
+    PrintPiece("reference piece", lockstep.reference.currentPiece);
+}
+
+template<int8_t Width, int8_t Height>
+static int PlayRepro(Repro const& repro) {
+    Divergence divergence = FirstDivergence<Width, Height>(repro.seed, repro.actions);
+    if (!divergence.what) {
+        printf("%zu actions, no divergence\n", repro.actions.size());
+        return 0;
+    }
+    Lockstep<Width, Height> lockstep(repro.seed);
+    for (size_t i = 0; i < divergence.step; ++i) {
+        lockstep.Apply(repro.actions[i]);
+    }
+    printf("%s differs after %zu actions%s%s\n", divergence.what, divergence.step,
+           divergence.step ? ", the last one " : "", divergence.step ? ActionNames[repro.actions[divergence.step - 1] & 7] : "");
+    PrintBoards(lockstep);
+    return 1;
+}
+
+struct Options {
+    uint64_t seed = 1;
+    size_t streams = 256;
+    size_t length = 100000;
+    size_t threads = DefaultThreadCount();
+    const char* out = "fuzz.repro";
+};
+
+template<int8_t Width, int8_t Height>
+static int Fuzz(Options const& options) {
+    // Workers check this between batches, so they stop soon after a divergence
+    static constexpr size_t Batch = 4096;
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> total{0};
+    std::mutex mutex;
+    size_t failedStream = SIZE_MAX;
+    Divergence failure{};
+
+    auto start = std::chrono::steady_clock::now();
+    ParallelFor(options.streams, options.threads, [&](size_t index, size_t) {
+        uint64_t seed = DeriveSeed(options.seed, index);
+        uint64_t state = seed;
+        Lockstep<Width, Height> lockstep(seed);
+        size_t done = 0;
+        const char* what = lockstep.Difference(true);
+        while (!what && done < options.length && !stop.load(std::memory_order_relaxed)) {
+            size_t end = std::min(done + Batch, options.length);
+            for (; done < end; ++done) {
+                if ((what = lockstep.Difference(lockstep.Apply(RandomAction(state, Width))))) {
+                    ++done;
+                    break;
+                }
+            }
+        }
+        total.fetch_add(done, std::memory_order_relaxed);
+        if (what) {
+            std::lock_guard lock(mutex);
+            if (index < failedStream) {
+                failedStream = index;
+                failure = {done, what};
+            }
+            stop.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        return !stop.load(std::memory_order_relaxed);
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double played = static_cast<double>(total.load());
+    printf("%.0f actions on %dx%d in %.2fs: %.2fM actions/s, %.2fM per thread\n", played, Width, Height, seconds,
+           played / seconds * 1e-6, played / seconds * 1e-6 / static_cast<double>(options.threads));
+
+    if (failedStream == SIZE_MAX) {
+        printf("No divergence in %zu streams of %zu actions\n", options.streams, options.length);
+        return 0;
+    }
+    uint64_t seed = DeriveSeed(options.seed, failedStream);
+    uint64_t state = seed;
+    Actions actions(failure.step);
+    for (uint8_t& action : actions) {
+        action = RandomAction(state, Width);
+    }
+    printf("Stream %zu: %s differs after %zu actions\n", failedStream, failure.what, failure.step);
+    actions = Minimise<Width, Height>(seed, std::move(actions));
+    Divergence minimised = FirstDivergence<Width, Height>(seed, actions);
+    if (!WriteRepro(options.out, Width, Height, seed, actions, minimised)) {
+        fprintf(stderr, "Failed to write %s\n", options.out);
+        return 1;
+    }
+    printf("Minimised to %zu actions (%s differs), written to %s\n", actions.size(), minimised.what, options.out);
+    return 1;
+}
+
+// The geometries the engine is built for elsewhere: the standard board, the
+// custom modes and a small one where walls and the floor are close
+template<typename Fn>
+static int WithBoard(int width, int height, Fn&& fn) {
+    if (width == 10 && height == 20) return fn.template operator()<10, 20>();
+    if (width == 16 && height == 24) return fn.template operator()<16, 24>();
+    if (width == 40 && height == 20) return fn.template operator()<40, 20>();
+    if (width == 6 && height == 12) return fn.template operator()<6, 12>();
+    fprintf(stderr, "Unsupported board %dx%d\n", width, height);
+    return 1;
+}
+
+
+void Usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --seed N       base seed of the run (default 1)\n"
+        "  --streams N    action streams (default 256)\n"
+        "  --length N     actions per stream (default 100000)\n"
+        "  --board WxH    10x20 (default), 16x24, 40x20 or 6x12\n"
+        "  --threads N    worker threads (default: all cores)\n"
+        "  --out F        where to write a divergence (default fuzz.repro)\n"
+        "  --repro F      replay a written divergence instead\n",
+        program);
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    int width = 10;
+    int height = 20;
+    const char* reproPath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i+1 < argc ? argv[++i] : nullptr;
+        if (!value) {
+            Usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "--seed") == 0) options.seed = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--streams") == 0) options.streams = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--length") == 0) options.length = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--threads") == 0) options.threads = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--out") == 0) options.out = value;
+        else if (strcmp(arg, "--repro") == 0) reproPath = value;
+        else if (strcmp(arg, "--board") == 0) {
+            if (sscanf(value, "%dx%d", &width, &height) != 2) {
+                Usage(argv[0]);
+                return 1;
+            }
+        }
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (reproPath) {
+        Repro repro;
+        if (!repro.Load(reproPath)) {
+            fprintf(stderr, "Failed to read %s\n", reproPath);
+            return 1;
+        }
+        return WithBoard(repro.width, repro.height, [&]<int8_t Width, int8_t Height>() {
+            return PlayRepro<Width, Height>(repro);
+        });
+    }
+    return WithBoard(width, height, [&]<int8_t Width, int8_t Height>() {
+        return Fuzz<Width, Height>(options);
+    });
+}
@@ -0,0 +1,210 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <random>
+#include <utility>
+#include <vector>
+
+#ifdef GRID_TERMINAL
+#include "platform_terminal_linux.hpp"
+#else
+#include "platform_sdl.hpp"
+#endif
+
+#include "tetris.hpp"
+#include "bot.hpp"
+#include "parallel.hpp"
+
+// Shows a grid of live bot games in one window (or one terminal with
+// -DGRID_TERMINAL). Every board draws into its own region of a single shared
+// framebuffer, which goes to the screen as one texture upload and one copy.
+// Boards whose version has not changed since they were last drawn are skipped,
+// and a frame in which no board changed is not presented at all. Everything
+// runs on one thread.
+
+static constexpr size_t MaxGrid = 8;
+static constexpr size_t BoardColumns = 18;  // Cells one Draw covers
+static constexpr size_t BoardRows = 22;
+
+struct Options {
+    size_t rows = 8;
+    size_t cols = 8;
+    double piecesPerSecond = 2;
+    size_t pressure = 4;
+    size_t scale = 0;  // 0 picks one that fits a typical display
+    uint64_t seed = 1;
+    Bot<> bot;
+};
+
+template<size_t Rows, size_t Cols>
+using GridScreen = Screen<BoardColumns * Cols, BoardRows * Rows>;
+
+template<size_t Rows, size_t Cols>
+static void Play(GridScreen<Rows, Cols>& screen, Options const& options) {
+    static constexpr size_t Boards = Rows * Cols;
+    screen.ClearBuffer();
+
+    std::vector<Tetris<>> games;
+    std::vector<uint64_t> episodes(Boards, 0);
+    std::vector<std::minstd_rand> holeRngs;
+    for (size_t i = 0; i < Boards; ++i) {
+        games.emplace_back(DeriveSeed(options.seed, i));
+        holeRngs.emplace_back(static_cast<uint32_t>(DeriveSeed(options.seed, i) >> 32));
+    }
+    std::vector<uint64_t> drawnVersion(Boards, UINT64_MAX);
+    std::vector<size_t> pieces(Boards, 0);
+
+    // Moves are staggered so the boards do not all change on the same frame
+    using clock = std::chrono::steady_clock;
+    auto moveInterval = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(1 / std::max(options.piecesPerSecond, 0.001)));
+    auto start = clock::now();
+    std::vector<clock::time_point> nextMove(Boards);
+    for (size_t i = 0; i < Boards; ++i) {
+        nextMove[i] = start + moveInterval * static_cast<long>(i) / static_cast<long>(Boards);
+    }
+
+    static constexpr size_t Framerate = 60;
+    static constexpr auto Timestep = clock::duration(1000ms) / Framerate;
+    auto nextFrame = start;
+    auto reportAt = start + 5s;
+    size_t frames = 0;
+    size_t presented = 0;
+    clock::duration busy{0};
+    clock::duration worst{0};
+
+    while (keepRunning) {
+        auto frameStart = clock::now();
+
+        for (size_t i = 0; i < Boards; ++i) {
+            if (frameStart < nextMove[i]) {
+                continue;
+            }
+            // If we fell behind, make one move rather than a burst
+            nextMove[i] = std::max(nextMove[i] + moveInterval, frameStart);
+
+            Tetris<>& game = games[i];
+            options.bot.Move(game);
+            ++pieces[i];
+            if (game.lastLinesCleared == 0 && pieces[i] % options.pressure == 0) {
+                game.AddGarbage(1, static_cast<int8_t>(holeRngs[i]() % 10));
+            }
+            if (game.gameOver) {
+                game = Tetris<>(DeriveSeed(DeriveSeed(options.seed, i), ++episodes[i]));
+                pieces[i] = 0;
+            }
+        }
+
+        bool changed = false;
+        for (size_t i = 0; i < Boards; ++i) {
+            if (games[i].version == drawnVersion[i]) {
+                continue;
+            }
+            drawnVersion[i] = games[i].version;
+            ScreenRegion<GridScreen<Rows, Cols>> region{screen, i % Cols * BoardColumns, i / Cols * BoardRows, BoardColumns, BoardRows};
+            games[i].Draw(region);
+            changed = true;
+        }
+        if (changed || screenDirty) {
+            screenDirty = false;
+            screen.RedrawScreen();
+#ifndef GRID_TERMINAL
+            SDL_RenderPresent(screen.GetRenderer());
+#endif
+            ++presented;
+        }
+
+        auto elapsed = clock::now() - frameStart;
+        busy += elapsed;
+        worst = std::max(worst, elapsed);
+        ++frames;
+        if (frameStart >= reportAt) {
+            fprintf(stderr, "%zu boards: %zu frames, %zu presented, %.2f ms average, %.2f ms worst\n",
+                    Boards, frames, presented,
+                    std::chrono::duration<double, std::milli>(busy).count() / static_cast<double>(frames),
+                    std::chrono::duration<double, std::milli>(worst).count());
+            reportAt += 5s;
+            frames = presented = 0;
+            busy = worst = clock::duration{0};
+        }
+
+        nextFrame += Timestep;
+        auto current = clock::now();
+        if (nextFrame < current) {
+            nextFrame = current;
+        }
+        PumpEvents(nextFrame);
+    }
+}
+
+template<size_t Rows, size_t Cols>
+int Watch(Options const& options) {
+    size_t scale = options.scale;
+    if (scale == 0) {
+        scale = std::clamp<size_t>(std::min(1600 / (BoardColumns * Cols), 1000 / (BoardRows * Rows)), 1, 25);
+    }
+
+    InitializeScreen();
+    {
+        // Gone before DestroyScreen tears SDL down
+        GridScreen<Rows, Cols> screen(scale);
+        Play<Rows, Cols>(screen, options);
+    }
+    DestroyScreen();
+    return 0;
+}
+
+// Watch<Rows, Cols> for every grid up to MaxGrid x MaxGrid
+template<size_t... I>
+static constexpr auto MakeWatchers(std::index_sequence<I...>) {
+    return std::array<int (*)(Options const&), sizeof...(I)>{&Watch<I / MaxGrid + 1, I % MaxGrid + 1>...};
+}
+static constexpr auto Watchers = MakeWatchers(std::make_index_sequence<MaxGrid * MaxGrid>{});
+
+
+void Usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --rows N       rows of boards, 1-8 (default 8)\n"
+        "  --cols N       columns of boards, 1-8 (default 8)\n"
+        "  --pps X        pieces per second on each board (default 2)\n"
+        "  --pressure N   one garbage line every N pieces without a clear (default 4)\n"
+        "  --scale N      window pixels per cell (default: fit the display)\n"
+        "  --weights W    bot weights height,lines,holes,bumpiness\n"
+        "  --seed N       base seed (default 1)\n",
+        program);
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i+1 < argc ? argv[++i] : nullptr;
+        if (!value) {
+            Usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "--rows") == 0) options.rows = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--cols") == 0) options.cols = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--pps") == 0) options.piecesPerSecond = strtod(value, nullptr);
+        else if (strcmp(arg, "--pressure") == 0) options.pressure = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--scale") == 0) options.scale = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--weights") == 0 && BotWeights::Parse(value, options.bot.weights)) {}
+        else if (strcmp(arg, "--seed") == 0) options.seed = strtoull(value, nullptr, 10);
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.rows < 1 || options.rows > MaxGrid || options.cols < 1 || options.cols > MaxGrid) {
+        Usage(argv[0]);
+        return 1;
+    }
+    return Watchers[(options.rows - 1) * MaxGrid + (options.cols - 1)](options);
+}
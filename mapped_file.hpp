@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// Memory mapping of a whole file: read-only with Open, or read-write with
+// OpenWritable, where stores go straight back to the file
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    uint8_t* writable = nullptr;  // Same as data for writable mappings
+    size_t size = 0;
+
+    MappedFile() = default;
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    ~MappedFile() { Close(); }
+
+#ifdef _WIN32
+    bool Open(const char* path) {
+        Close();
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!mapping) {
+            return false;
+        }
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping);
+        if (!data) {
+            return false;
+        }
+        size = static_cast<size_t>(fileSize.QuadPart);
+        return true;
+    }
+
+    // Creates the file if needed and makes it exactly `bytes` long
+    bool OpenWritable(const char* path, size_t bytes) {
+        Close();
+        HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        fileSize.QuadPart = static_cast<LONGLONG>(bytes);
+        if (bytes == 0 || !SetFilePointerEx(file, fileSize, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!mapping) {
+            return false;
+        }
+        writable = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+        CloseHandle(mapping);
+        if (!writable) {
+            return false;
+        }
+        data = writable;
+        size = bytes;
+        return true;
+    }
+
+    void Close() {
+        if (data) {
+            UnmapViewOfFile(data);
+        }
+        data = nullptr;
+        writable = nullptr;
+        size = 0;
+    }
+#else
+    bool Open(const char* path) {
+        Close();
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0 || st.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        void* mapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+        data = static_cast<const uint8_t*>(mapping);
+        size = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    // Creates the file if needed and makes it exactly `bytes` long
+    bool OpenWritable(const char* path, size_t bytes) {
+        Close();
+        int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        if (bytes == 0 || ftruncate(fd, static_cast<off_t>(bytes)) < 0) {
+            close(fd);
+            return false;
+        }
+        void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+        writable = static_cast<uint8_t*>(mapping);
+        data = writable;
+        size = bytes;
+        return true;
+    }
+
+    void Close() {
+        if (data) {
+            munmap(const_cast<uint8_t*>(data), size);
+        }
+        data = nullptr;
+        writable = nullptr;
+        size = 0;
+    }
+#endif
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "splitmix.hpp"
+
+
+inline size_t DefaultThreadCount() {
+    size_t count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+// Seed for the index-th job of a run, so every job is reproducible on its own.
+// splitmix64 keeps neighbouring jobs from getting related sequences.
+inline uint64_t DeriveSeed(uint64_t baseSeed, uint64_t index) {
+    uint64_t state = baseSeed + index * 0x9E3779B97F4A7C15ull;
+    return SplitMix64(state);
+}
+
+// Runs fn(worker) once on each of `threads` threads and waits for all of them
+void RunOnThreads(size_t threads, auto&& fn) {
+    if (threads <= 1) {
+        fn(size_t{0});
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (size_t worker = 0; worker < threads; ++worker) {
+        workers.emplace_back([&fn, worker] { fn(worker); });
+    }
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+}
+
+// Hands out indices [0, count) to the workers in order. fn(index, worker)
+// returns false to stop handing out new indices; ones already started finish.
+void ParallelFor(size_t count, size_t threads, auto&& fn) {
+    std::atomic<size_t> next{0};
+    std::atomic<bool> stop{false};
+    RunOnThreads(threads, [&](size_t worker) {
+        while (!stop.load(std::memory_order_relaxed)) {
+            size_t index = next.fetch_add(1, std::memory_order_relaxed);
+            if (index >= count) {
+                break;
+            }
+            if (!fn(index, worker)) {
+                stop.store(true, std::memory_order_relaxed);
+            }
+        }
+    });
+}
+
+// Lets workers finish items out of order while a single consumer takes them
+// in order. Push blocks while its index is `capacity` or more ahead of the
+// next one to be taken, which bounds memory; with ParallelFor handing out
+// indices in order, the oldest outstanding item can always be pushed.
+template<typename T>
+struct ReorderQueue {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::optional<T>> slots;
+    size_t next = 0;
+
+    explicit ReorderQueue(size_t capacity) : slots(capacity) {}
+
+    void Push(size_t index, T value) {
+        std::unique_lock lock{mutex};
+        changed.wait(lock, [&] { return index < next + slots.size(); });
+        slots[index % slots.size()] = std::move(value);
+        changed.notify_all();
+    }
+
+    T Pop() {
+        std::unique_lock lock{mutex};
+        std::optional<T>& slot = slots[next % slots.size()];
+        changed.wait(lock, [&] { return slot.has_value(); });
+        T value = std::move(*slot);
+        slot.reset();
+        ++next;
+        changed.notify_all();
+        return value;
+    }
+};
@@ -0,0 +1,164 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "tetris.hpp"
+#include "replay.hpp"
+#include "perfect_clear.hpp"
+
+// Perfect-clear analysis of a position: the chance of clearing the bottom
+// --lines rows exactly under best play, for every placement of the piece in
+// play or the held one, and the best line while the pieces are known. The
+// position is the opening of a seeded game, or a move of a saved replay.
+//
+// Solved positions are kept in a memory-mapped memo file, so analysing the
+// same openings again starts warm.
+
+static constexpr char PieceNames[] = ".IJLOSTZG";
+
+static void PrintBoard(uint64_t board, int8_t lines) {
+    for (int8_t y = static_cast<int8_t>(lines - 1); y >= 0; --y) {
+        printf("  |");
+        for (int8_t x = 0; x < PerfectClear::Columns; ++x) {
+            putchar(board >> (y * PerfectClear::Columns + x) & 1 ? '#' : '.');
+        }
+        printf("|\n");
+    }
+}
+
+static void PrintMove(PerfectClear::Move const& move) {
+    printf("%c%s rotation %d column %d", PieceNames[move.type], move.hold ? " (hold)" : "", move.rotation, move.px);
+}
+
+static int Analyse(PerfectClear const& solver, Tetris<> const& game, int8_t lines, size_t preview, size_t top) {
+    PerfectClear::State state;
+    if (game.gameOver || !PerfectClear::FromGame(game, lines, preview, state)) {
+        printf("The stack is taller than %d lines\n", lines);
+        return 1;
+    }
+
+    printf("Board, current %c, hold %c, queue ", PieceNames[state.current], PieceNames[state.hold]);
+    for (size_t i = 0; i < state.queueLength; ++i) {
+        putchar(PieceNames[state.queue[i]]);
+    }
+    printf("\n");
+    PrintBoard(state.board, lines);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<PerfectClear::Move> moves = solver.Analyse(state);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (moves.empty() || moves[0].value <= 0) {
+        printf("No perfect clear within %d lines (%.2fs)\n", lines, seconds);
+        return 0;
+    }
+    printf("Perfect clear chance %.2f%% (%.2fs)\n", 100.0 * moves[0].value, seconds);
+    for (size_t i = 0; i < std::min(top, moves.size()) && moves[i].value > 0; ++i) {
+        printf("  %6.2f%%  ", 100.0 * moves[i].value);
+        PrintMove(moves[i]);
+        printf("\n");
+    }
+
+    std::vector<PerfectClear::Move> line = solver.Line(state);
+    printf("Best line%s:\n", !line.empty() && line.back().lines == 0 ? " to the perfect clear" : " while the pieces are known");
+    for (PerfectClear::Move const& move : line) {
+        printf("  ");
+        PrintMove(move);
+        printf("  %.2f%%\n", 100.0 * move.value);
+        PrintBoard(move.board, move.lines);
+    }
+    return 0;
+}
+
+
+void Usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --seed N       analyse the opening of the game with this seed (default 1)\n"
+        "  --openings N   analyse the openings of N seeds from --seed on (default 1)\n"
+        "  --replay F     analyse a position from a saved replay instead\n"
+        "  --move N       the position after N moves of the replay (default 0)\n"
+        "  --lines N      rows to clear, 1-6 (default 4)\n"
+        "  --preview N    queue pieces known, 1-7 (default 5, as the game shows)\n"
+        "  --top N        moves to list (default 5)\n"
+        "  --memo F       memo file (default perfect_clear.memo)\n"
+        "  --memo-mb N    size of a new memo file (default 256)\n"
+        "  --threads N    search threads (default: all cores)\n",
+        program);
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t seed = 1;
+    size_t openings = 1;
+    const char* replayPath = nullptr;
+    size_t move = 0;
+    size_t lines = 4;
+    size_t preview = 5;
+    size_t top = 5;
+    const char* memoPath = "perfect_clear.memo";
+    size_t memoMegabytes = 256;
+    PerfectClear solver;
+    solver.threads = DefaultThreadCount();
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i+1 < argc ? argv[++i] : nullptr;
+        if (!value) {
+            Usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "--seed") == 0) seed = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--openings") == 0) openings = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--replay") == 0) replayPath = value;
+        else if (strcmp(arg, "--move") == 0) move = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--lines") == 0) lines = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--preview") == 0) preview = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--top") == 0) top = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--memo") == 0) memoPath = value;
+        else if (strcmp(arg, "--memo-mb") == 0) memoMegabytes = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--threads") == 0) solver.threads = std::max(1ull, strtoull(value, nullptr, 10));
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (lines < 1 || lines > PerfectClear::MaxLines || preview < 1 || preview > 7) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    PerfectClearMemo memo;
+    if (!memo.Open(memoPath, memoMegabytes)) {
+        fprintf(stderr, "Failed to open memo %s\n", memoPath);
+        return 1;
+    }
+    solver.memo = memo.table.get();
+    printf("Memo %s: %zu MB, %s\n", memoPath, (memo.file.size - sizeof(PerfectClearMemo::Header)) >> 20,
+           memo.warm ? "reused" : "new");
+
+    if (replayPath) {
+        Replay replay;
+        std::vector<Tetris<>> positions;
+        if (!replay.Load(replayPath) || !replay.Play([&](Tetris<> const& game) { positions.push_back(game); })) {
+            fprintf(stderr, "Failed to read %s\n", replayPath);
+            return 1;
+        }
+        if (move >= positions.size()) {
+            fprintf(stderr, "%s has %zu moves\n", replayPath, positions.size() - 1);
+            return 1;
+        }
+        return Analyse(solver, positions[move], static_cast<int8_t>(lines), preview, top);
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < openings; ++i) {
+        printf("%sSeed %llu\n", i ? "\n" : "", static_cast<unsigned long long>(seed + i));
+        result |= Analyse(solver, Tetris<>(seed + i), static_cast<int8_t>(lines), preview, top);
+    }
+    return result;
+}
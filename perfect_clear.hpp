@@ -0,0 +1,433 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <memory>
+#include <vector>
+
+#include "tetris.hpp"
+#include "transposition.hpp"
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+
+// Perfect-clear search on a standard 10-wide board: can the cells in the
+// bottom `lines` rows be filled exactly, clearing all of them, and how likely
+// is that under best play?
+//
+// Pieces are placed the way the bot places them: rotated and shifted in the
+// spawn row, then hard dropped. With the stack inside the bottom few rows of a
+// 20-row board, every such placement is reachable. The piece in play, hold and
+// the preview are known. Pieces past the preview come out of the 7-bag the way
+// NextFromBag deals them, and each is treated as unknown until it is played,
+// so the probability is the one for a player who does not see the preview
+// refill: a lower bound on what a real player can get.
+//
+// Solved positions go into a TranspositionTable keyed on everything that
+// decides the result. Laid over a memory-mapped file (PerfectClearMemo) it
+// keeps them from one run to the next.
+
+struct PerfectClear {
+    using Game = Tetris<10, 20>;
+    using Tetromino = Game::Tetromino;
+    using Type = Tetromino::Type;
+
+    static constexpr int8_t Columns = 10;
+    static constexpr int8_t MaxLines = 6;  // The board fits in 64 bits
+    static constexpr size_t MaxQueue = 14;
+    static constexpr uint8_t AllTypes = 0xFE;  // Bit 1 << type for I to Z
+
+    // Bit y * Columns + x; y = 0 is the floor
+    static constexpr uint64_t RowMask = (uint64_t{1} << Columns) - 1;
+    static constexpr uint64_t LeftColumn = [] {
+        uint64_t mask = 0;
+        for (int8_t y = 0; y < MaxLines; ++y) {
+            mask |= uint64_t{1} << (y * Columns);
+        }
+        return mask;
+    }();
+    static constexpr uint64_t RightColumn = LeftColumn << (Columns - 1);
+
+    static constexpr uint64_t LinesMask(int8_t lines) {
+        return lines >= MaxLines ? (uint64_t{1} << (MaxLines * Columns)) - 1 : (uint64_t{1} << (lines * Columns)) - 1;
+    }
+
+    struct State {
+        uint64_t board = 0;
+        int8_t lines = 4;  // Rows still to clear
+        Type current = Type::None;
+        Type hold = Type::None;
+        bool canHold = true;
+        uint8_t queueTop = 0;
+        uint8_t queueLength = 0;  // Known pieces from queueTop on
+        Type queue[MaxQueue]{};
+        uint8_t bag = 0;  // Types left in the bag the next unknown piece comes from; 0 is a fresh bag
+    };
+
+    // One way a piece can land: its cells with the lowest row at y = 0
+    struct Shape {
+        uint64_t bits;
+        int8_t height;
+        int8_t rotation;
+        int8_t px;
+    };
+
+    struct Shapes {
+        size_t count;
+        Shape shapes[4 * Columns];
+    };
+
+    // Shapes[type], from the engine's piece masks. Rotations that cover the
+    // same cells (O, and pairs of I, S and Z) appear once.
+    static constexpr auto ShapeTable = [] {
+        std::array<Shapes, Type::Z + 1> table{};
+        for (size_t type = Type::I; type <= Type::Z; ++type) {
+            Shapes& shapes = table[type];
+            for (int8_t rotation = 0; rotation < 4; ++rotation) {
+                for (int8_t px = 0; px < Columns; ++px) {
+                    Game::PieceMask const& mask = Game::PieceMasks[type][rotation][px];
+                    if (mask.outside) {
+                        continue;
+                    }
+                    Shape shape{0, mask.rows, rotation, px};
+                    for (int8_t r = 0; r < mask.rows; ++r) {
+                        shape.bits |= uint64_t{mask.row[r]} << ((mask.rows - 1 - r) * Columns);
+                    }
+                    bool seen = false;
+                    for (size_t i = 0; i < shapes.count; ++i) {
+                        seen |= shapes.shapes[i].bits == shape.bits;
+                    }
+                    if (!seen) {
+                        shapes.shapes[shapes.count++] = shape;
+                    }
+                }
+            }
+        }
+        return table;
+    }();
+
+    struct Move {
+        Type type = Type::None;
+        bool hold = false;
+        int8_t rotation = 0;
+        int8_t px = 0;
+        float value = 0;
+        uint64_t board = 0;  // After the move and any clears
+        int8_t lines = 0;
+    };
+
+    TranspositionTable* memo = nullptr;
+    size_t threads = 1;
+
+    // The position the game is in, or false if its stack is taller than `lines`
+    static bool FromGame(Game const& game, int8_t lines, size_t preview, State& state) {
+        if (*std::min_element(game.columnTop, game.columnTop + Columns) < 20 - lines) {
+            return false;
+        }
+        state = State{};
+        for (int8_t y = 0; y < lines; ++y) {
+            state.board |= uint64_t{game.rowBits[19 - y]} << (y * Columns);
+        }
+        state.lines = lines;
+        state.current = game.currentPiece.type;
+        state.hold = game.holdType;
+        state.canHold = !game.alreadySwapped;
+        size_t end = std::min<size_t>(game.pieceQueueTop + preview, MaxQueue - 1);
+        state.queueLength = static_cast<uint8_t>(end - game.pieceQueueTop);
+        for (size_t i = 0; i < state.queueLength; ++i) {
+            state.queue[i] = game.pieceQueue[game.pieceQueueTop + i];
+        }
+        // The queue holds this bag and the next; the first unknown piece comes
+        // from whichever one `end` falls in
+        state.bag = AllTypes;
+        for (size_t i = end / 7 * 7; i < end; ++i) {
+            state.bag &= static_cast<uint8_t>(~(1u << game.pieceQueue[i]));
+        }
+        if (state.bag == AllTypes) {
+            state.bag = 0;
+        }
+        return true;
+    }
+
+    static uint64_t Key(State const& state) {
+        uint64_t queue = 0;
+        for (size_t i = 0; i < state.queueLength; ++i) {
+            queue = queue << 3 | state.queue[state.queueTop + i];
+        }
+        uint64_t meta = static_cast<uint64_t>(state.lines) | uint64_t{state.current} << 4 |
+            uint64_t{state.hold} << 8 | uint64_t{state.canHold} << 12 |
+            uint64_t{state.bag} << 16 | uint64_t{state.queueLength} << 24;
+        uint64_t mix = state.board;
+        uint64_t key = SplitMix64(mix);
+        mix ^= meta;
+        key ^= SplitMix64(mix);
+        mix ^= queue;
+        return key ^ SplitMix64(mix);
+    }
+
+    // Every empty region of the remaining rows has to be filled by whole pieces
+    static bool Fillable(uint64_t board, int8_t lines) {
+        uint64_t empty = ~board & LinesMask(lines);
+        while (empty) {
+            uint64_t region = empty & (~empty + 1);
+            for (;;) {
+                uint64_t grown = region | (region << 1 & ~LeftColumn) | (region >> 1 & ~RightColumn) |
+                    region << Columns | region >> Columns;
+                grown &= empty;
+                if (grown == region) {
+                    break;
+                }
+                region = grown;
+            }
+            if (std::popcount(region) % 4 != 0) {
+                return false;
+            }
+            empty &= ~region;
+        }
+        return true;
+    }
+
+    // Hard drops a shape; false if it would stick out above the remaining rows
+    static bool Drop(Shape const& shape, uint64_t& board, int8_t& lines) {
+        int8_t y = lines;
+        while (y > 0 && !(shape.bits << ((y - 1) * Columns) & board)) {
+            --y;
+        }
+        if (y + shape.height > lines) {
+            return false;
+        }
+        board |= shape.bits << (y * Columns);
+        for (int8_t row = lines - 1; row >= 0; --row) {
+            if ((board >> (row * Columns) & RowMask) == RowMask) {
+                uint64_t below = board & ((uint64_t{1} << (row * Columns)) - 1);
+                board = below | (board >> ((row + 1) * Columns)) << (row * Columns);
+                --lines;
+            }
+        }
+        return true;
+    }
+
+    // Average of fn(type, state) over the next piece: the front of the known
+    // queue, or each type left in the bag
+    static double Draw(State state, auto&& fn) {
+        if (state.queueLength > 0) {
+            Type type = state.queue[state.queueTop];
+            ++state.queueTop;
+            --state.queueLength;
+            return fn(type, state);
+        }
+        uint8_t bag = state.bag ? state.bag : AllTypes;
+        double sum = 0;
+        for (uint8_t types = bag; types; types &= types - 1) {
+            Type type = static_cast<Type>(std::countr_zero(types));
+            State next = state;
+            next.bag = static_cast<uint8_t>(bag & ~(1u << type));
+            sum += fn(type, next);
+        }
+        return sum / std::popcount(bag);
+    }
+
+    // The current piece has just been placed, leaving `state`
+    double AfterPlacement(State state) const {
+        if (state.lines == 0) {
+            return 1;
+        }
+        if (!Fillable(state.board, state.lines)) {
+            return 0;
+        }
+        state.canHold = true;
+        return Draw(state, [&](Type type, State next) {
+            next.current = type;
+            return Value(next);
+        });
+    }
+
+    // Probability of a perfect clear with state.current in play
+    double Value(State const& state) const {
+        uint64_t key = Key(state);
+        // Pieces still needed; never 0, which the table reads as empty
+        uint8_t depth = static_cast<uint8_t>((state.lines * Columns - std::popcount(state.board)) / 4);
+        float stored;
+        if (memo && memo->Probe(key, depth, stored)) {
+            return stored;
+        }
+
+        double best = 0;
+        Shapes const& shapes = ShapeTable[state.current];
+        for (size_t i = 0; i < shapes.count && best < 1; ++i) {
+            State next = state;
+            if (Drop(shapes.shapes[i], next.board, next.lines)) {
+                best = std::max(best, AfterPlacement(next));
+            }
+        }
+        if (best < 1 && state.canHold) {
+            if (state.hold != Type::None) {
+                if (state.hold != state.current) {
+                    State swapped = state;
+                    swapped.current = state.hold;
+                    swapped.hold = state.current;
+                    swapped.canHold = false;
+                    best = std::max(best, Value(swapped));
+                }
+            }
+            else {
+                best = std::max(best, Draw(state, [&](Type type, State swapped) {
+                    swapped.current = type;
+                    swapped.hold = state.current;
+                    swapped.canHold = false;
+                    return Value(swapped);
+                }));
+            }
+        }
+
+        // Round like a table hit would, so hits and misses agree
+        best = static_cast<float>(best);
+        if (memo) {
+            memo->Store(key, depth, static_cast<float>(best));
+        }
+        return best;
+    }
+
+    // The state with hold pressed, if the piece that comes into play is known
+    static bool Held(State const& state, State& held) {
+        if (!state.canHold || state.hold == state.current) {
+            return false;
+        }
+        held = state;
+        held.hold = state.current;
+        held.canHold = false;
+        if (state.hold != Type::None) {
+            held.current = state.hold;
+            return true;
+        }
+        if (state.queueLength == 0) {
+            return false;
+        }
+        held.current = state.queue[state.queueTop];
+        ++held.queueTop;
+        --held.queueLength;
+        return true;
+    }
+
+    // Every move from the position with its probability, best first. The
+    // moves are searched on `threads` threads sharing the memo.
+    std::vector<Move> Analyse(State const& state) const {
+        std::vector<Move> moves;
+        std::vector<State> after;
+        auto AddMoves = [&](State const& from, bool hold) {
+            Shapes const& shapes = ShapeTable[from.current];
+            for (size_t i = 0; i < shapes.count; ++i) {
+                State next = from;
+                Shape const& shape = shapes.shapes[i];
+                if (Drop(shape, next.board, next.lines)) {
+                    moves.push_back({from.current, hold, shape.rotation, shape.px, 0, next.board, next.lines});
+                    after.push_back(next);
+                }
+            }
+        };
+        AddMoves(state, false);
+        State held;
+        if (Held(state, held)) {
+            AddMoves(held, true);
+        }
+
+        if (memo) {
+            memo->NewSearch();
+        }
+        ParallelFor(moves.size(), threads, [&](size_t i, size_t) {
+            moves[i].value = static_cast<float>(AfterPlacement(after[i]));
+            return true;
+        });
+        std::stable_sort(moves.begin(), moves.end(), [](Move const& a, Move const& b) {
+            return a.value > b.value;
+        });
+        return moves;
+    }
+
+    // The best line from the position for as long as the pieces are known.
+    // Stops at a perfect clear, when nothing works, or when the next choice
+    // depends on a piece past the preview.
+    std::vector<Move> Line(State state) const {
+        std::vector<Move> line;
+        while (state.lines > 0) {
+            std::vector<Move> moves = Analyse(state);
+            if (moves.empty() || moves[0].value <= 0) {
+                break;
+            }
+            Move const& best = moves[0];
+            line.push_back(best);
+            State next = state;
+            if (best.hold) {
+                Held(state, next);
+            }
+            next.board = best.board;
+            next.lines = best.lines;
+            next.canHold = true;
+            if (next.lines == 0 || next.queueLength == 0) {
+                break;
+            }
+            next.current = next.queue[next.queueTop];
+            ++next.queueTop;
+            --next.queueLength;
+            state = next;
+        }
+        return line;
+    }
+};
+
+
+// A PerfectClear memo in a file, so solved positions carry over between runs.
+// The file is a 64-byte header followed by the table's entries.
+struct PerfectClearMemo {
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint8_t age;     // The table's search age, carried between runs
+        uint8_t reserved[3];
+        uint64_t bytes;  // Of entries
+        uint8_t padding[40];
+    };
+    static_assert(sizeof(Header) == 64, "entries start on a cache line");
+
+    static constexpr char Magic[8] = {'T', 'T', 'R', 'S', 'M', 'E', 'M', 'O'};
+    // Bump when the search or the key changes what a stored value means
+    static constexpr uint32_t Version = 1;
+
+    MappedFile file;
+    std::unique_ptr<TranspositionTable> table;
+    bool warm = false;  // The file already held a memo
+
+    // Reuses the memo at `path` if it is valid, whatever its size; otherwise
+    // starts a new one of `megabytes`
+    bool Open(const char* path, size_t megabytes) {
+        size_t bytes = sizeof(Header) + (megabytes << 20);
+        warm = false;
+        if (file.Open(path) && file.size > sizeof(Header)) {
+            Header header;
+            memcpy(&header, file.data, sizeof(header));
+            if (memcmp(header.magic, Magic, sizeof(Magic)) == 0 && header.version == Version &&
+                header.bytes == file.size - sizeof(Header)) {
+                bytes = file.size;
+                warm = true;
+            }
+        }
+        if (!file.OpenWritable(path, bytes)) {
+            return false;
+        }
+        if (!warm) {
+            memset(file.writable, 0, bytes);
+            Header header{};
+            memcpy(header.magic, Magic, sizeof(Magic));
+            header.version = Version;
+            header.bytes = bytes - sizeof(Header);
+            memcpy(file.writable, &header, sizeof(header));
+        }
+        table = std::make_unique<TranspositionTable>(file.writable + sizeof(Header), bytes - sizeof(Header),
+                                                     file.writable + offsetof(Header, age));
+        return true;
+    }
+};
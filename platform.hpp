@@ -1,11 +1,19 @@
 #pragma once
 
 #include <cstdint>
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <chrono>
 using namespace std::chrono_literals;
 
+#include "tracer.hpp"
+
+struct SDL_Renderer;
+
 struct Color {
     constexpr static uint32_t Black = 0x000000;
     constexpr static uint32_t White = 0xFFFFFF;
@@ -17,21 +25,53 @@ struct Color {
     constexpr static uint32_t Blue = 0x3333FF;
     constexpr static uint32_t Green = 0x00FF00;
     constexpr static uint32_t Red = 0xFF0000;
+    constexpr static uint32_t Gray = 0x7F7F7F;
 
     constexpr Color(uint32_t x=Black) : value{x} {}
     constexpr operator uint32_t() const { return value; }
 
     uint32_t value;
 
-    Color DimColor(uint8_t tint) const {
-        // This is almost definitely the wrong way to do this
+    constexpr Color DimColor(uint8_t tint) const {
         return
-            (uint32_t(((value & 0xFF0000) >> 16) * tint / 256.0) << 16) |
-            (uint32_t(((value & 0x00FF00) >> 8) * tint / 256.0) << 8) |
-            (uint32_t(((value & 0x0000FF) >> 0) * tint / 256.0) << 0);
+            ((((value & 0xFF0000) >> 16) * tint >> 8) << 16) |
+            ((((value & 0x00FF00) >> 8) * tint >> 8) << 8) |
+            ((((value & 0x0000FF) >> 0) * tint >> 8) << 0);
     }
 };
 
+// The framebuffer holds a palette index per cell rather than a colour. The low
+// bits are the piece type (same order as Tetromino::Type) or White for the
+// border, and Ghost marks the dimmed ghost piece. Colours are looked up only
+// when a frame is handed to the screen.
+struct Palette {
+    static constexpr uint8_t White = 9;
+    static constexpr uint8_t Ghost = 0x10;
+    static constexpr size_t Size = 0x20;
+
+    static constexpr Color Base[White + 1] = {
+        Color::Black,  // None
+        Color::Cyan,   // I
+        Color::Blue,   // J
+        Color::Orange, // L
+        Color::Yellow, // O
+        Color::Green,  // S
+        Color::Pink,   // T
+        Color::Red,    // Z
+        Color::Gray,   // Garbage
+        Color::White,
+    };
+
+    static constexpr std::array<Color, Size> Colors = [] {
+        std::array<Color, Size> colors{};
+        for (size_t i = 0; i <= White; ++i) {
+            colors[i] = Base[i];
+            colors[i | Ghost] = Base[i].DimColor(127);
+        }
+        return colors;
+    }();
+};
+
 namespace KeyPress {
     enum KeyPress : int {
         None = 0, Left, Right, Up, Down, Space, c, z, r, COUNT,
@@ -40,6 +80,8 @@ namespace KeyPress {
 
 using timepoint = std::chrono::system_clock::duration::rep;
 inline volatile bool keepRunning = true;
+// Set when the window needs repainting even though the game has not changed
+inline volatile bool screenDirty = true;
 inline volatile timepoint lastPress[KeyPress::COUNT];
 inline volatile timepoint lastRelease[KeyPress::COUNT];
 
@@ -47,6 +89,98 @@ inline bool IsKeyPressed(KeyPress::KeyPress key) {
     return lastPress[key] > lastRelease[key];
 }
 
+struct InputEvent {
+    timepoint time;  // When the platform saw the key change, not when it was handled
+    KeyPress::KeyPress key;
+    bool pressed;
+};
+
+// Key changes travel from the thread that pumps platform events to the thread
+// that runs the game through this single-producer, single-consumer ring. Only
+// the consumer writes lastPress and lastRelease, inside ApplyInput().
+struct InputQueue {
+    static constexpr size_t Capacity = 256;
+
+    InputEvent events[Capacity];
+    std::atomic<size_t> head{0};  // Next slot to read
+    std::atomic<size_t> tail{0};  // Next slot to write
+
+    // Lets the consumer sleep until there is input instead of polling
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    bool woken = false;
+
+    // Drops the event if the game has fallen this far behind
+    bool Push(InputEvent event) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        events[t % Capacity] = event;
+        tail.store(t + 1, std::memory_order_release);
+        Wake();
+        return true;
+    }
+
+    // Sleeps until an event is queued, Wake is called or `deadline` passes
+    void WaitUntil(std::chrono::steady_clock::time_point deadline) {
+        std::unique_lock lock{wakeMutex};
+        wake.wait_until(lock, deadline, [this] {
+            return woken || head.load(std::memory_order_acquire) != tail.load(std::memory_order_acquire);
+        });
+        woken = false;
+    }
+
+    void Wake() {
+        // Taking the lock orders this with a waiter's check of the queue, so
+        // the notification cannot slip in between the check and the wait
+        {
+            std::lock_guard lock{wakeMutex};
+            woken = true;
+        }
+        wake.notify_one();
+    }
+
+    bool Pop(InputEvent& event) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        event = events[h % Capacity];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+inline InputQueue inputQueue;
+
+// Folds queued key changes into the key state, in the order they happened.
+// Auto-repeat presses keep the time of the first press so DAS is unaffected.
+// Returns the time of the earliest new press, or 0 if there was none.
+inline timepoint ApplyInput() {
+    timepoint firstPress = 0;
+    for (InputEvent event; inputQueue.Pop(event);) {
+#ifdef TETRIS_TRACE
+        // Placed on the timeline when the key changed, not when it was applied
+        auto age = std::chrono::system_clock::now() - std::chrono::system_clock::time_point(std::chrono::system_clock::duration(event.time));
+        TRACE_INSTANT_AGO(event.pressed ? "key press" : "key release", event.key,
+                          std::chrono::duration_cast<std::chrono::nanoseconds>(age).count());
+#endif
+        if (event.pressed) {
+            if (lastPress[event.key] <= lastRelease[event.key]) {
+                lastPress[event.key] = event.time;
+                if (!firstPress) {
+                    firstPress = event.time;
+                }
+            }
+        }
+        else {
+            lastRelease[event.key] = event.time;
+        }
+    }
+    return firstPress;
+}
+
 
 template<size_t Width, size_t Height>
 class Screen {
@@ -55,7 +189,8 @@ class Screen {
     std::unique_ptr<Impl> pimpl;
 
 public:
-    Screen();
+    // scale: window pixels per cell, where the backend has pixels
+    explicit Screen(size_t scale = 25);
     //     : Impl{std::make_unique<Impl>}
     // {
     //     ClearBuffer();
@@ -64,13 +199,47 @@ public:
     ~Screen();// = default;
 
     void ClearBuffer();
-    void SetPixel(size_t x, size_t y, Color color);
+    void SetPixel(size_t x, size_t y, uint8_t index);
     void ClearScreen();
     void RedrawScreen();
     SDL_Renderer* GetRenderer() const;
+
+    // Offscreen backend only: the frame RedrawScreen rasterised, as RGB24
+    // rows, and text drawn on top of it in pixel coordinates
+    const uint8_t* Pixels() const;
+    size_t PixelWidth() const;
+    size_t PixelHeight() const;
+    void DrawText(size_t x, size_t y, const char* text, Color color);
+};
+
+// A Width x Height window into a larger screen, so several games can Draw
+// into one framebuffer side by side
+template<typename ScreenT>
+struct ScreenRegion {
+    ScreenT& screen;
+    size_t left;
+    size_t top;
+    size_t width;
+    size_t height;
+
+    void ClearBuffer() {
+        for (size_t y = 0; y < height; ++y) {
+            for (size_t x = 0; x < width; ++x) {
+                screen.SetPixel(left + x, top + y, 0);
+            }
+        }
+    }
+
+    void SetPixel(size_t x, size_t y, uint8_t index) {
+        if (x < width && y < height) {
+            screen.SetPixel(left + x, top + y, index);
+        }
+    }
 };
 
 
 void InitializeScreen();
 void DestroyScreen();
+// Handles platform events until the deadline, sleeping while there are none
+void PumpEvents(std::chrono::steady_clock::time_point deadline);
 void ContinuouslyReadInput();
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "platform.hpp"
+
+// Screen without a display: RedrawScreen rasterises the palette framebuffer
+// into an RGB buffer in memory, scale pixels per cell, and DrawText writes a
+// small built-in bitmap font over it. Used to render replays to video on
+// headless machines; nothing here touches SDL or the terminal.
+
+template<size_t Width, size_t Height>
+struct Screen<Width, Height>::Impl {
+    uint8_t buffer[Width * Height];
+    size_t scale;
+    std::vector<uint8_t> pixels;  // RGB24
+};
+
+template<size_t Width, size_t Height>
+void Screen<Width, Height>::ClearBuffer() {
+    memset(pimpl->buffer, 0, sizeof(pimpl->buffer));
+}
+
+template<size_t Width, size_t Height>
+void Screen<Width, Height>::SetPixel(size_t x, size_t y, uint8_t index) {
+    if (x < Width && y < Height) {
+        pimpl->buffer[x + y * Width] = index;
+    }
+}
+
+template<size_t Width, size_t Height>
+void Screen<Width, Height>::ClearScreen() {
+    std::fill(pimpl->pixels.begin(), pimpl->pixels.end(), 0);
+}
+
+template<size_t Width, size_t Height>
+void Screen<Width, Height>::RedrawScreen() {
+    size_t scale = pimpl->scale;
+    size_t stride = Width * scale * 3;
+    for (size_t y = 0; y < Height; ++y) {
+        // Build one pixel row of the cell row, then copy it down
+        uint8_t* row = &pimpl->pixels[y * scale * stride];
+        for (size_t x = 0; x < Width; ++x) {
+            uint32_t color = Palette::Colors[pimpl->buffer[x + y * Width] & (Palette::Size - 1)];
+            uint8_t rgb[3] = {
+                static_cast<uint8_t>(color >> 16),
+                static_cast<uint8_t>(color >> 8),
+                static_cast<uint8_t>(color),
+            };
+            for (size_t i = 0; i < scale; ++i) {
+                memcpy(row + (x * scale + i) * 3, rgb, 3);
+            }
+        }
+        for (size_t i = 1; i < scale; ++i) {
+            memcpy(row + i * stride, row, stride);
+        }
+    }
+}
+
+template<size_t Width, size_t Height>
+SDL_Renderer* Screen<Width, Height>::GetRenderer() const {
+    return nullptr;
+}
+
+template<size_t Width, size_t Height>
+const uint8_t* Screen<Width, Height>::Pixels() const {
+    return pimpl->pixels.data();
+}
+
+template<size_t Width, size_t Height>
+size_t Screen<Width, Height>::PixelWidth() const {
+    return Width * pimpl->scale;
+}
+
+template<size_t Width, size_t Height>
+size_t Screen<Width, Height>::PixelHeight() const {
+    return Height * pimpl->scale;
+}
+
+// 5x7 glyphs, one byte per row, bit 4 is the leftmost column. Only what the
+// replay overlay prints; anything else is drawn as a space. DrawText draws
+// each glyph pixel as a square of scale / 8 pixels, so text keeps its size
+// relative to the cells.
+struct Glyph {
+    char c;
+    uint8_t rows[7];
+};
+
+static constexpr Glyph Glyphs[] = {
+    {'0', {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}},
+    {'1', {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'2', {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}},
+    {'3', {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}},
+    {'4', {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}},
+    {'5', {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}},
+    {'6', {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}},
+    {'7', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {'8', {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}},
+    {'9', {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}},
+    {'A', {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+    {'C', {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}},
+    {'E', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}},
+    {'G', {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}},
+    {'L', {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}},
+    {'M', {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}},
+    {'O', {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'R', {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}},
+    {'S', {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}},
+    {'V', {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}},
+};
+
+template<size_t Width, size_t Height>
+void Screen<Width, Height>::DrawText(size_t x, size_t y, const char* text, Color color) {
+    size_t width = PixelWidth();
+    size_t height = PixelHeight();
+    uint8_t rgb[3] = {
+        static_cast<uint8_t>(color >> 16),
+        static_cast<uint8_t>(color >> 8),
+        static_cast<uint8_t>(color),
+    };
+    size_t size = std::max<size_t>(1, pimpl->scale / 8);
+    for (; *text; ++text, x += 6 * size) {
+        for (Glyph const& glyph : Glyphs) {
+            if (glyph.c != *text) {
+                continue;
+            }
+            for (size_t py = 0; py < 7 * size; ++py) {
+                for (size_t px = 0; px < 5 * size; ++px) {
+                    if ((glyph.rows[py / size] >> (4 - px / size) & 1) && x + px < width && y + py < height) {
+                        memcpy(&pimpl->pixels[((y + py) * width + x + px) * 3], rgb, 3);
+                    }
+                }
+            }
+        }
+    }
+}
+
+template<size_t Width, size_t Height>
+Screen<Width, Height>::Screen(size_t scale)
+    : pimpl{std::make_unique<Impl>()}
+{
+    pimpl->scale = scale;
+    pimpl->pixels.assign(Width * scale * Height * scale * 3, 0);
+    ClearBuffer();
+}
+
+template<size_t Width, size_t Height>
+Screen<Width, Height>::~Screen() = default;
+
+
+void InitializeScreen() {}
+void DestroyScreen() {}
+
+void PumpEvents(std::chrono::steady_clock::time_point deadline) {
+    std::this_thread::sleep_until(deadline);
+}
+
+void ContinuouslyReadInput() {}
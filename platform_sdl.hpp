@@ -10,6 +10,7 @@
 
 
 #include "platform.hpp"
+#include "profiler.hpp"
 
 
 #define SDL_CHECK_CODE(x) SDLCheckCode(x, __FILE__, __LINE__)
@@ -36,74 +37,76 @@ static T* SDLCheckPtr(T* ptr, const char* file, int line) {
     return ptr;
 }
 
-static void PollEvents() {
-    for (SDL_Event e; SDL_PollEvent(&e);) {
-        switch (e.type) {
-            case SDL_QUIT: {
-                keepRunning = false;
-            } break;
-
-            case SDL_KEYDOWN:
-            case SDL_KEYUP: {
-                bool pressed = e.type == SDL_KEYDOWN;
-                SDL_Keycode code = e.key.keysym.sym;
-                // SDL_Keymod mod = static_cast<SDL_Keymod>(e.key.keysym.mod);
-
-                timepoint now = std::chrono::system_clock::now().time_since_epoch().count();
-
-                KeyPress::KeyPress key;
-                switch (code) {
-                    case SDLK_LEFT:  key = KeyPress::Left;  break;
-                    case SDLK_RIGHT: key = KeyPress::Right; break;
-                    case SDLK_UP:    key = KeyPress::Up;    break;
-                    case SDLK_DOWN:  key = KeyPress::Down;  break;
-                    case SDLK_SPACE: key = KeyPress::Space; break;
-                    case SDLK_c:     key = KeyPress::c;     break;
-                    case SDLK_r:     key = KeyPress::r;     break;
-                    case SDLK_z:     key = KeyPress::z;     break;
-                    default:         key = KeyPress::None;  break;
-                }
-
-                if (key == KeyPress::None) {
-                    break;
-                }
-
-                if (pressed) {
-                    bool isFirstPress = lastPress[key] <= lastRelease[key];
-                    if (isFirstPress) {
-                        lastPress[key] = now;
-                    }
-                }
-                else {
-                    lastRelease[key] = now;
-                }
-            } break;
-        }
+// SDL event timestamps are milliseconds since SDL_Init; this converts them
+static timepoint sdlEpoch;
+
+static void HandleEvent(SDL_Event const& e) {
+    switch (e.type) {
+        case SDL_QUIT: {
+            keepRunning = false;
+        } break;
+
+        case SDL_WINDOWEVENT: {
+            screenDirty = true;
+        } break;
+
+        case SDL_KEYDOWN:
+        case SDL_KEYUP: {
+            bool pressed = e.type == SDL_KEYDOWN;
+            SDL_Keycode code = e.key.keysym.sym;
+            // SDL_Keymod mod = static_cast<SDL_Keymod>(e.key.keysym.mod);
+
+#ifdef TETRIS_PROFILE
+            if (code == SDLK_F3 && pressed && !e.key.repeat) {
+                profileOverlay = !profileOverlay;
+                screenDirty = true;
+                break;
+            }
+#endif
+
+            timepoint time = sdlEpoch + std::chrono::system_clock::duration(std::chrono::milliseconds(e.key.timestamp)).count();
+
+            KeyPress::KeyPress key;
+            switch (code) {
+                case SDLK_LEFT:  key = KeyPress::Left;  break;
+                case SDLK_RIGHT: key = KeyPress::Right; break;
+                case SDLK_UP:    key = KeyPress::Up;    break;
+                case SDLK_DOWN:  key = KeyPress::Down;  break;
+                case SDLK_SPACE: key = KeyPress::Space; break;
+                case SDLK_c:     key = KeyPress::c;     break;
+                case SDLK_r:     key = KeyPress::r;     break;
+                case SDLK_z:     key = KeyPress::z;     break;
+                default:         key = KeyPress::None;  break;
+            }
+
+            if (key == KeyPress::None) {
+                break;
+            }
+
+            inputQueue.Push({.time=time, .key=key, .pressed=pressed});
+        } break;
     }
 }
 
 
-static constexpr size_t Scale = 25;
-
 template<size_t Width, size_t Height>
 struct Screen<Width, Height>::Impl {
-	Color buffer[Width * Height];
+	uint8_t buffer[Width * Height];
 
     SDL_Window* window;
     SDL_Renderer* renderer;
+    SDL_Texture* texture;
 };
 
 template<size_t Width, size_t Height>
 void Screen<Width, Height>::ClearBuffer() {
-    for (size_t i = 0; i < Width * Height; ++i) {
-        pimpl->buffer[i] = Color::Black;
-    }
+    memset(pimpl->buffer, 0, sizeof(pimpl->buffer));
 }
 
 template<size_t Width, size_t Height>
-void Screen<Width, Height>::SetPixel(size_t x, size_t y, Color color) {
+void Screen<Width, Height>::SetPixel(size_t x, size_t y, uint8_t index) {
     if (x < Width && y < Height) {
-        pimpl->buffer[x + y * Width] = color;
+        pimpl->buffer[x + y * Width] = index;
     }
 }
 
@@ -120,64 +123,85 @@ template<size_t Width, size_t Height>
 
 template<size_t Width, size_t Height>
 void Screen<Width, Height>::RedrawScreen() {
-    PollEvents();
-
-    uint32_t prevColor;
-    auto SetColor = [&prevColor, this](uint32_t color) {
-        SDL_SetRenderDrawColor(pimpl->renderer,
-               (color & 0xFF0000) >> 16,
-               (color & 0x00FF00) >> 8,
-               (color & 0x0000FF) >> 0,
-               255);
-        prevColor = color;
-    };
-    SetColor(0);
-
+    // One texel per cell, written straight into the streaming texture and
+    // stretched to the window in a single copy
+    void* texels;
+    int pitch;
+    SDL_CHECK_CODE(SDL_LockTexture(pimpl->texture, nullptr, &texels, &pitch));
     for (size_t y = 0; y < Height; ++y) {
+        uint32_t* row = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(texels) + y * static_cast<size_t>(pitch));
+        uint8_t const* cells = pimpl->buffer + y * Width;
         for (size_t x = 0; x < Width; ++x) {
-            uint32_t color = pimpl->buffer[x + y * Width];
-
-            if (color != prevColor) {
-                SetColor(color);
-            }
-
-            SDL_Rect r{.x=static_cast<int>(x*Scale), .y=static_cast<int>(y*Scale),.w=Scale,.h=Scale};
-            SDL_RenderFillRect(pimpl->renderer, &r);
+            row[x] = Palette::Colors[cells[x] & (Palette::Size - 1)] | 0xFF000000;
         }
     }
+    SDL_UnlockTexture(pimpl->texture);
+    SDL_CHECK_CODE(SDL_RenderCopy(pimpl->renderer, pimpl->texture, nullptr, nullptr));
 }
 
 
 template<size_t Width, size_t Height>
-Screen<Width, Height>::Screen()
+Screen<Width, Height>::Screen(size_t scale)
     : pimpl{std::make_unique<Impl>()}
 {
     pimpl->window = SDL_CHECK_PTR(SDL_CreateWindow(
         "Tetris",
         SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-        Width * Scale, Height * Scale,
+        static_cast<int>(Width * scale), static_cast<int>(Height * scale),
         0));
 
-    pimpl->renderer = SDL_CHECK_PTR(SDL_CreateRenderer(
+    pimpl->renderer = SDL_CreateRenderer(
         pimpl->window,
         -1,
-        SDL_RENDERER_ACCELERATED));
+        SDL_RENDERER_ACCELERATED);
+    if (!pimpl->renderer) {
+        // No GPU, e.g. the dummy video driver used by the benchmarks
+        pimpl->renderer = SDL_CHECK_PTR(SDL_CreateRenderer(
+            pimpl->window,
+            -1,
+            SDL_RENDERER_SOFTWARE));
+    }
+
+    pimpl->texture = SDL_CHECK_PTR(SDL_CreateTexture(
+        pimpl->renderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        Width, Height));
 }
 
 template<size_t Width, size_t Height>
-Screen<Width, Height>::~Screen() = default;
+Screen<Width, Height>::~Screen() {
+    SDL_DestroyTexture(pimpl->texture);
+    SDL_DestroyRenderer(pimpl->renderer);
+    SDL_DestroyWindow(pimpl->window);
+}
 
 
-void ContinuouslyReadInput() {
+// SDL is only ever touched from the main thread. It sleeps in the event wait,
+// so a key press is handled as soon as it arrives rather than on the next poll.
+void PumpEvents(std::chrono::steady_clock::time_point deadline) {
     while (keepRunning) {
-        PollEvents();
-        // Don't kill cpu
-        std::this_thread::sleep_for(1ms);
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0) {
+            break;
+        }
+        SDL_Event e;
+        if (SDL_WaitEventTimeout(&e, static_cast<int>(remaining.count()))) {
+            HandleEvent(e);
+        }
+    }
+    for (SDL_Event e; SDL_PollEvent(&e);) {
+        HandleEvent(e);
     }
 }
 
+// Events are pumped by PumpEvents on the main thread
+void ContinuouslyReadInput() {}
+
 void InitializeScreen() {
     SDL_CHECK_CODE(SDL_Init(SDL_INIT_VIDEO));
+    sdlEpoch = std::chrono::system_clock::now().time_since_epoch().count() -
+        std::chrono::system_clock::duration(std::chrono::milliseconds(SDL_GetTicks())).count();
 }
 
 void DestroyScreen() {
@@ -3,10 +3,12 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
+#include <algorithm>
 #include <memory>
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <termios.h>
 #include <linux/input.h>
 #include <csignal>
@@ -15,30 +17,31 @@
 
 static constexpr size_t HorizontalStretch = 2;
 static constexpr size_t VerticalStretch = 1;
+// The input thread looks at keepRunning at least this often, in milliseconds,
+// so joining it at exit does not wait for a key
+static constexpr int StopPollInterval = 100;
 
 template<size_t Width, size_t Height>
 struct Screen<Width, Height>::Impl {
     static constexpr size_t BufferSize = Width * HorizontalStretch * Height * VerticalStretch;
 
-	Color buffer[BufferSize];
+	uint8_t buffer[BufferSize];
 };
 
 template<size_t Width, size_t Height>
 void Screen<Width, Height>::ClearBuffer() {
-    for (size_t i = 0; i < pimpl->BufferSize; ++i) {
-        pimpl->buffer[i] = Color::Black;
-    }
+    memset(pimpl->buffer, 0, sizeof(pimpl->buffer));
 }
 
 template<size_t Width, size_t Height>
-void Screen<Width, Height>::SetPixel(size_t x, size_t y, Color color) {
+void Screen<Width, Height>::SetPixel(size_t x, size_t y, uint8_t index) {
     if (x < Width && y < Height) {
         for (size_t dy = 0; dy < VerticalStretch; ++dy) {
             for (size_t dx = 0; dx < HorizontalStretch; ++dx) {
                 size_t idx_x = x * HorizontalStretch + dx;
                 size_t idx_y = y * VerticalStretch + dy;
                 size_t idx_w = Width * HorizontalStretch;
-                pimpl->buffer[idx_x + idx_y * idx_w] = color;
+                pimpl->buffer[idx_x + idx_y * idx_w] = index;
             }
         }
     }
@@ -54,21 +57,22 @@ void Screen<Width, Height>::RedrawScreen() {
     // Cursor to home, buffer
     printf("\x1b[H");
 
-    uint32_t prevColor;
-    auto SetColor = [&prevColor](uint32_t color) {
+    uint8_t prevIndex;
+    auto SetColor = [&prevIndex](uint8_t index) {
+        uint32_t color = Palette::Colors[index & (Palette::Size - 1)];
         printf("\x1b[48;2;%d;%d;%dm",
                (color & 0xFF0000) >> 16,
                (color & 0x00FF00) >> 8,
                (color & 0x0000FF) >> 0);
-        prevColor = color;
+        prevIndex = index;
     };
     SetColor(0);
 
     for (size_t y = 0; y < Height*VerticalStretch; ++y) {
         for (size_t x = 0; x < Width*HorizontalStretch; ++x) {
-            uint32_t color = pimpl->buffer[x + y * Width * HorizontalStretch];
-            if (color != prevColor) {
-                SetColor(color);
+            uint8_t index = pimpl->buffer[x + y * Width * HorizontalStretch];
+            if (index != prevIndex) {
+                SetColor(index);
             }
             // TODO: Coalesce prints
             putchar(' ');
@@ -82,7 +86,7 @@ void Screen<Width, Height>::RedrawScreen() {
 
 
 template<size_t Width, size_t Height>
-Screen<Width, Height>::Screen()
+Screen<Width, Height>::Screen(size_t)
     : pimpl{std::make_unique<Impl>()}
 {
     ClearBuffer();
@@ -94,8 +98,12 @@ Screen<Width, Height>::~Screen() = default;
 
 
 static struct termios original_termios;
+static volatile bool kittyKeyboardPushed = false;
 
 static void ResetTerminalMode() {
+    if (kittyKeyboardPushed) {
+        fputs("\e[<u", stdout); // Pop the keyboard flags pushed by the input thread
+    }
     tcsetattr(0, TCSANOW, &original_termios);
     puts("\e[?25h"); // Show cursor
 }
@@ -112,6 +120,12 @@ static void SetTerminalToRawMode() {
     memcpy(&new_termios, &original_termios, sizeof(new_termios));
     new_termios.c_lflag &= static_cast<tcflag_t>(~ICANON);
     new_termios.c_lflag &= static_cast<tcflag_t>(~ECHO);
+    // Reads return whatever has arrived, possibly nothing, instead of
+    // blocking; the input thread waits in poll(). O_NONBLOCK would do the
+    // same, but stdout usually shares the file description and would
+    // start failing writes with EAGAIN.
+    new_termios.c_cc[VMIN] = 0;
+    new_termios.c_cc[VTIME] = 0;
     tcsetattr(0, TCSANOW, &new_termios);
 }
 
@@ -121,48 +135,314 @@ static void CustomExit(int) {
 }
 
 
-void ContinuouslyReadInput() {
-    // FIXME: This is bad
-    int keyboard_fd = open("/dev/input/event2", O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+// Input is read on its own thread
+void PumpEvents(std::chrono::steady_clock::time_point deadline) {
+    std::this_thread::sleep_until(deadline);
+}
+
+static timepoint Now() {
+    return std::chrono::system_clock::now().time_since_epoch().count();
+}
+
+static KeyPress::KeyPress KeyForCharacter(uint32_t code) {
+    switch (code) {
+        case ' ':           return KeyPress::Space;
+        case 'c': case 'C': return KeyPress::c;
+        case 'z': case 'Z': return KeyPress::z;
+        case 'r': case 'R': return KeyPress::r;
+        default:            return KeyPress::None;
+    }
+}
+
+static KeyPress::KeyPress KeyForArrow(char final) {
+    switch (final) {
+        case 'A': return KeyPress::Up;
+        case 'B': return KeyPress::Down;
+        case 'C': return KeyPress::Right;
+        case 'D': return KeyPress::Left;
+        default:  return KeyPress::None;
+    }
+}
+
+// Turns the bytes a terminal sends on stdin into key presses and releases.
+//
+// A plain terminal only sends a key when it goes down and again on every
+// auto-repeat, never when it comes up, so releases are made up: a key that
+// has not been seen for a while is let go. The first press is released after
+// TapRelease, which is short enough that a tap never charges DAS but longer
+// than the 33-40 ms between auto-repeats, so the second repeat finds the key
+// still down. From then on the key is held until RepeatRelease after the last
+// repeat. Holding a direction therefore moves once, again when auto-repeat
+// starts, and then at DAS speed.
+//
+// Terminals that speak the kitty keyboard protocol report real presses and
+// releases. Its flags are pushed and queried at start; once the terminal
+// answers the query, the timeouts are no longer used.
+struct TerminalKeys {
+    static constexpr timepoint TapRelease = std::chrono::system_clock::duration(60ms).count();
+    static constexpr timepoint RepeatRelease = std::chrono::system_clock::duration(100ms).count();
+    // A lone Escape, or a sequence cut short, is dropped after this long
+    static constexpr timepoint PartialTimeout = std::chrono::system_clock::duration(50ms).count();
+
+    bool kitty = false;
+    timepoint releaseAt[KeyPress::COUNT] = {};  // 0 while up, or with kitty
+    char pending[64];
+    size_t pendingLength = 0;
+    timepoint pendingSince = 0;
+
+    void Press(KeyPress::KeyPress key, timepoint now) {
+        if (key == KeyPress::None) {
+            return;
+        }
+        if (releaseAt[key]) {
+            releaseAt[key] = now + RepeatRelease;
+            return;
+        }
+        releaseAt[key] = now + TapRelease;
+        inputQueue.Push({.time=now, .key=key, .pressed=true});
+    }
+
+    // With the kitty protocol: 1 pressed, 2 repeated, 3 released
+    void Event(KeyPress::KeyPress key, int event, timepoint now) {
+        if (key == KeyPress::None || event == 2) {
+            return;
+        }
+        inputQueue.Push({.time=now, .key=key, .pressed=event != 3});
+    }
+
+    // CSI [number[:number]][;number[:number]] final
+    void ControlSequence(const char* params, size_t length, char final, timepoint now) {
+        if (length > 0 && params[0] == '?') {
+            // The answer to the kitty keyboard query
+            if (final == 'u') {
+                kitty = true;
+            }
+            return;
+        }
+        int fields[2][2] = {{1, 0}, {1, 1}};  // {code, -}, {modifiers, event}
+        size_t field = 0;
+        size_t part = 0;
+        int value = -1;
+        for (size_t i = 0; i <= length; ++i) {
+            char byte = i < length ? params[i] : ';';
+            if (byte >= '0' && byte <= '9') {
+                value = (value < 0 ? 0 : value * 10) + (byte - '0');
+                continue;
+            }
+            if (field < 2 && part < 2 && value >= 0) {
+                fields[field][part] = value;
+            }
+            value = -1;
+            if (byte == ':') {
+                ++part;
+            }
+            else if (byte == ';') {
+                ++field;
+                part = 0;
+            }
+        }
+        int code = fields[0][0];
+        int modifiers = fields[1][0] - 1;
+        int event = fields[1][1];
+
+        KeyPress::KeyPress key = KeyPress::None;
+        if (final == 'u') {
+            // With the protocol on, Ctrl+C arrives as a key instead of SIGINT
+            if (code == 'c' && (modifiers & 4) && event != 3) {
+                raise(SIGINT);
+                return;
+            }
+            key = KeyForCharacter(static_cast<uint32_t>(code));
+        }
+        else if (code == 1) {
+            key = KeyForArrow(final);
+        }
+        if (kitty) {
+            Event(key, event, now);
+        }
+        else {
+            Press(key, now);
+        }
+    }
+
+    // Handles every complete key in `bytes` and returns how many bytes that
+    // used; an escape sequence cut off at the end is left for the next read
+    size_t Parse(const char* bytes, size_t length, timepoint now) {
+        size_t i = 0;
+        while (i < length) {
+            if (bytes[i] != '\e') {
+                Press(KeyForCharacter(static_cast<unsigned char>(bytes[i])), now);
+                ++i;
+                continue;
+            }
+            if (i + 1 == length) {
+                return i;
+            }
+            if (bytes[i + 1] == 'O') {
+                // Arrows in application cursor mode
+                if (i + 2 == length) {
+                    return i;
+                }
+                Press(KeyForArrow(bytes[i + 2]), now);
+                i += 3;
+                continue;
+            }
+            if (bytes[i + 1] != '[') {
+                // Escape itself, or Alt with a key: not used
+                ++i;
+                continue;
+            }
+            size_t end = i + 2;
+            while (end < length && (bytes[end] < 0x40 || bytes[end] > 0x7e)) {
+                ++end;
+            }
+            if (end == length) {
+                return i;
+            }
+            ControlSequence(bytes + i + 2, end - i - 2, bytes[end], now);
+            i = end + 1;
+        }
+        return i;
+    }
+
+    void Read(timepoint now) {
+        ssize_t len = read(0, pending + pendingLength, sizeof(pending) - pendingLength);
+        if (len <= 0) {
+            return;
+        }
+        pendingLength += static_cast<size_t>(len);
+        size_t used = Parse(pending, pendingLength, now);
+        if (used == 0 && pendingLength == sizeof(pending)) {
+            used = pendingLength;  // No key sequence is this long
+        }
+        memmove(pending, pending + used, pendingLength - used);
+        pendingLength -= used;
+        pendingSince = now;
+    }
+
+    // Lets go of keys that have not been seen for long enough, and of a
+    // partial sequence nothing followed
+    void Expire(timepoint now) {
+        for (size_t key = 0; key < KeyPress::COUNT; ++key) {
+            if (releaseAt[key] && (kitty || releaseAt[key] <= now)) {
+                inputQueue.Push({.time=std::min(releaseAt[key], now), .key=static_cast<KeyPress::KeyPress>(key), .pressed=false});
+                releaseAt[key] = 0;
+            }
+        }
+        if (pendingLength && pendingSince + PartialTimeout <= now) {
+            pendingLength = 0;
+        }
+    }
+
+    // How long poll() may sleep before Expire has something to do, or -1
+    int Timeout(timepoint now) const {
+        timepoint next = pendingLength ? pendingSince + PartialTimeout : 0;
+        for (timepoint at : releaseAt) {
+            if (at && (!next || at < next)) {
+                next = at;
+            }
+        }
+        if (!next) {
+            return -1;
+        }
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(std::chrono::system_clock::duration(next - now));
+        return static_cast<int>(std::max<std::chrono::milliseconds::rep>(wait.count(), 0));
+    }
+};
+
+static void ReadTerminalInput() {
+    // Disambiguate keys (1), report releases (2) and report every key as an
+    // escape sequence (8), then ask which flags took; terminals without the
+    // protocol ignore both
+    kittyKeyboardPushed = true;
+    fputs("\e[>11u\e[?u", stdout);
+    fflush(stdout);
+
+    TerminalKeys keys;
+    pollfd stdinFd{.fd = 0, .events = POLLIN, .revents = 0};
+    while (keepRunning) {
+        int timeout = keys.Timeout(Now());
+        if (timeout < 0 || timeout > StopPollInterval) {
+            timeout = StopPollInterval;
+        }
+        int ready = poll(&stdinFd, 1, timeout);
+        timepoint now = Now();
+        if (ready > 0) {
+            if (stdinFd.revents & (POLLHUP | POLLERR | POLLNVAL)) {
+                return;
+            }
+            keys.Read(now);
+        }
+        keys.Expire(now);
+    }
+}
+
+// Reads a keyboard device directly, which has real releases and kernel
+// timestamps but needs read access to /dev/input (root or the input group)
+static void ReadKeyboardDevice(const char* path) {
+    int keyboard_fd = open(path, O_RDONLY | O_CLOEXEC);
     if (keyboard_fd < 0) {
         perror("Error opening device");
         exit(1);
     }
 
     struct input_event events[32];
-    while (true) {
-        ssize_t len;
-        while ((len = read(keyboard_fd, events, sizeof(events))) > 0) {
-            len /= sizeof(events[0]);
-            for (size_t i = 0; i < static_cast<size_t>(len); ++i) {
-
-                struct input_event *event = &events[i];
-                if (event->type == EV_KEY) {
-                    // 0 = released
-                    // 1 = pressed
-                    // 2 = held
-                    if (event->value == 2) {
-                        continue;
-                    }
-                    bool pressed = event->value != 0;
-                    timepoint now = std::chrono::system_clock::now().time_since_epoch().count();
-
-                    switch (event->code) {
-                        case 105: (pressed ? lastPress : lastRelease)[KeyPress::Left]  = now; break;
-                        case 106: (pressed ? lastPress : lastRelease)[KeyPress::Right] = now; break;
-                        case 103: (pressed ? lastPress : lastRelease)[KeyPress::Up]    = now; break;
-                        case 108: (pressed ? lastPress : lastRelease)[KeyPress::Down]  = now; break;
-                        case 57:  (pressed ? lastPress : lastRelease)[KeyPress::Space] = now; break;
-                        case 46:  (pressed ? lastPress : lastRelease)[KeyPress::c]     = now; break;
-                        case 19:  (pressed ? lastPress : lastRelease)[KeyPress::r]     = now; break;
-                        case 44:  (pressed ? lastPress : lastRelease)[KeyPress::z]     = now; break;
-                    }
+    pollfd keyboardFd{.fd = keyboard_fd, .events = POLLIN, .revents = 0};
+    while (keepRunning) {
+        if (poll(&keyboardFd, 1, StopPollInterval) <= 0) {
+            continue;
+        }
+        ssize_t len = read(keyboard_fd, events, sizeof(events));
+        if (len <= 0) {
+            break;
+        }
+        len /= sizeof(events[0]);
+        for (size_t i = 0; i < static_cast<size_t>(len); ++i) {
+
+            struct input_event *event = &events[i];
+            if (event->type == EV_KEY) {
+                // 0 = released
+                // 1 = pressed
+                // 2 = held
+                if (event->value == 2) {
+                    continue;
+                }
+                bool pressed = event->value != 0;
+                // The kernel stamps events with the realtime clock
+                timepoint time = std::chrono::system_clock::duration(
+                    std::chrono::seconds(event->time.tv_sec) +
+                    std::chrono::microseconds(event->time.tv_usec)).count();
+
+                KeyPress::KeyPress key;
+                switch (event->code) {
+                    case 105: key = KeyPress::Left;  break;
+                    case 106: key = KeyPress::Right; break;
+                    case 103: key = KeyPress::Up;    break;
+                    case 108: key = KeyPress::Down;  break;
+                    case 57:  key = KeyPress::Space; break;
+                    case 46:  key = KeyPress::c;     break;
+                    case 19:  key = KeyPress::r;     break;
+                    case 44:  key = KeyPress::z;     break;
+                    default:  key = KeyPress::None;  break;
+                }
+                if (key != KeyPress::None) {
+                    inputQueue.Push({.time=time, .key=key, .pressed=pressed});
                 }
-                // Ignore all other event types
             }
+            // Ignore all other event types
         }
-        // Don't kill cpu
-        std::this_thread::sleep_for(1ms);
+    }
+    close(keyboard_fd);
+}
+
+// Keys come from stdin, so the terminal build works over SSH and in
+// containers. TETRIS_KEYBOARD=/dev/input/eventN reads that device instead.
+void ContinuouslyReadInput() {
+    if (const char* device = getenv("TETRIS_KEYBOARD")) {
+        ReadKeyboardDevice(device);
+    }
+    else {
+        ReadTerminalInput();
     }
 }
 
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+
+// Frame-phase profiler, compiled in with -DTETRIS_PROFILE. Without it the
+// PROFILE_* macros expand to nothing and no profiler state exists.
+//
+// Every phase is recorded by exactly one thread (Update on the simulation
+// thread, the rest on the render thread), so each histogram has a single
+// writer and needs no read-modify-write; other threads only read it.
+
+namespace ProfilePhase {
+    enum ProfilePhase : size_t {
+        Update = 0, Draw, Redraw, Text, Present, InputLatency, COUNT,
+    };
+}
+
+static constexpr const char* ProfilePhaseNames[ProfilePhase::COUNT] = {
+    "update", "draw", "redraw", "text", "present", "input-latency",
+};
+
+#ifdef TETRIS_PROFILE
+// Toggled with F3
+inline volatile bool profileOverlay = false;
+#endif
+
+
+// Log-linear histogram of nanosecond values. Each power of two is split into
+// SubBuckets linear steps, so any recorded value is off by at most 1/SubBuckets.
+struct HdrHistogram {
+    static constexpr size_t SubBucketBits = 5;
+    static constexpr size_t SubBuckets = size_t{1} << SubBucketBits;
+    static constexpr size_t Magnitudes = 64 - SubBucketBits;
+    static constexpr size_t BucketCount = (Magnitudes + 1) * SubBuckets;
+
+    std::atomic<uint64_t> counts[BucketCount]{};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+
+    static size_t Bucket(uint64_t value) {
+        if (value < SubBuckets) {
+            return static_cast<size_t>(value);
+        }
+        size_t magnitude = static_cast<size_t>(std::bit_width(value)) - SubBucketBits;
+        size_t sub = static_cast<size_t>(value >> (magnitude - 1)) & (SubBuckets - 1);
+        return magnitude * SubBuckets + sub;
+    }
+
+    // Largest value that lands in the bucket
+    static uint64_t BucketValue(size_t bucket) {
+        size_t magnitude = bucket / SubBuckets;
+        uint64_t sub = bucket % SubBuckets;
+        if (magnitude == 0) {
+            return sub;
+        }
+        return (((SubBuckets | sub) + 1) << (magnitude - 1)) - 1;
+    }
+
+    // Single writer only
+    void Record(uint64_t value) {
+        auto Bump = [](std::atomic<uint64_t>& a, uint64_t by) {
+            a.store(a.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+        };
+        Bump(counts[Bucket(value)], 1);
+        Bump(total, 1);
+        Bump(sum, value);
+        if (value > max.load(std::memory_order_relaxed)) {
+            max.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t Count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t Max() const { return max.load(std::memory_order_relaxed); }
+
+    uint64_t Mean() const {
+        uint64_t count = Count();
+        return count ? sum.load(std::memory_order_relaxed) / count : 0;
+    }
+
+    // p in [0, 1]
+    uint64_t Percentile(double p) const {
+        uint64_t count = Count();
+        uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BucketCount; ++i) {
+            seen += counts[i].load(std::memory_order_relaxed);
+            if (seen > rank) {
+                uint64_t value = BucketValue(i);
+                return value < Max() ? value : Max();
+            }
+        }
+        return Max();
+    }
+};
+
+
+struct Profiler {
+    HdrHistogram phases[ProfilePhase::COUNT];
+
+    // One line per phase, times in microseconds
+    bool WriteCsv(const char* path) const {
+        FILE* file = fopen(path, "w");
+        if (!file) {
+            return false;
+        }
+        fprintf(file, "phase,count,mean_us,p50_us,p90_us,p99_us,p999_us,max_us\n");
+        for (size_t i = 0; i < ProfilePhase::COUNT; ++i) {
+            HdrHistogram const& h = phases[i];
+            fprintf(file, "%s,%llu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                    ProfilePhaseNames[i], static_cast<unsigned long long>(h.Count()),
+                    static_cast<double>(h.Mean()) / 1000,
+                    static_cast<double>(h.Percentile(0.5)) / 1000,
+                    static_cast<double>(h.Percentile(0.9)) / 1000,
+                    static_cast<double>(h.Percentile(0.99)) / 1000,
+                    static_cast<double>(h.Percentile(0.999)) / 1000,
+                    static_cast<double>(h.Max()) / 1000);
+        }
+        return fclose(file) == 0;
+    }
+};
+
+struct ProfileScope {
+    HdrHistogram& histogram;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    ~ProfileScope() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        histogram.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+};
+
+#ifdef TETRIS_PROFILE
+inline Profiler profiler;
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_CONCAT(profileScope, __LINE__){profiler.phases[phase]}
+#define PROFILE_RECORD(phase, nanoseconds) profiler.phases[phase].Record(nanoseconds)
+#else
+#define PROFILE_SCOPE(phase) ((void)0)
+#define PROFILE_RECORD(phase, nanoseconds) ((void)0)
+#endif
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <random>
+
+#include "tetris.hpp"
+
+// The rules of Tetris written as plainly as possible, one cell at a time,
+// to check the engine against. Nothing here is meant to be fast: collision
+// walks the four minos, kicks are worked out from the SRS offset tables on
+// every rotation, drops move one row at a time and line clears copy rows
+// down one by one. It shares only data with the engine (the rotation and
+// offset tables, the Zobrist keys and the bag shuffle), so an optimisation
+// of PieceHitWall, Rotate, DistanceFromFloor, PlacePiece or ClearLines that
+// changes the rules makes the two disagree. See fuzz.cpp.
+//
+// Fields mirror Tetris so the two can be compared directly.
+template<int8_t Width=10, int8_t Height=20>
+struct ReferenceTetris {
+    using Game = Tetris<Width, Height>;
+    using Tetromino = typename Game::Tetromino;
+    using Type = typename Tetromino::Type;
+
+    std::minstd_rand rng;
+    size_t pieceQueueTop;
+    Type pieceQueue[14];
+    Type board[Height][Width];
+    Tetromino currentPiece;
+    Type holdType = Type::None;
+    bool alreadySwapped = false;
+    bool gameOver = false;
+    int level = 1;
+    int linesCleared = 0;
+    long score = 0;
+    int lastLinesCleared = 0;
+
+    // Same seed, same pieces as Tetris(seed)
+    explicit ReferenceTetris(uint64_t seed)
+        : rng(static_cast<uint32_t>(seed ^ (seed >> 32)))
+    {
+        ResetGame();
+    }
+
+    bool Filled(int8_t x, int8_t y) const {
+        return board[y][x] != Type::None;
+    }
+
+    // Off the sides or below the floor; above the board is open
+    bool HitWall(int8_t x, int8_t y) const {
+        if (x < 0 || x >= Width || y >= Height) {
+            return true;
+        }
+        return y >= 0 && Filled(x, y);
+    }
+
+    bool PieceHitWall(Tetromino piece, int8_t dx = 0, int8_t dy = 0) const {
+        for (size_t i = 0; i < 4; ++i) {
+            typename Tetromino::Mino mino = piece.GetMino(i);
+            if (HitWall(mino.x + dx, mino.y + dy)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // https://tetris.wiki/Super_Rotation_System
+    void Rotate(Tetromino& piece, bool clockwise) const {
+        typename Tetromino::Mino const (*offsets)[5] =
+            piece.type == Type::I ? Tetromino::Ioffsets :
+            piece.type == Type::O ? Tetromino::Ooffsets :
+            Tetromino::JLSTZoffsets;
+        int8_t from = piece.rotation;
+        int8_t to = static_cast<int8_t>((from + (clockwise ? 1 : 3)) % 4);
+        Tetromino rotated = piece;
+        rotated.rotation = to;
+        for (size_t test = 0; test < 5; ++test) {
+            int8_t dx = offsets[from][test].x - offsets[to][test].x;
+            int8_t dy = offsets[from][test].y - offsets[to][test].y;
+            if (!PieceHitWall(rotated, dx, dy)) {
+                rotated.px += dx;
+                rotated.py += dy;
+                piece = rotated;
+                return;
+            }
+        }
+    }
+
+    // Rows the piece can fall, or -1 if it already overlaps the stack (as a
+    // piece swapped in from hold can)
+    int8_t DistanceFromFloor(Tetromino piece) const {
+        int8_t rows = 0;
+        while (!PieceHitWall(piece, 0, rows)) {
+            ++rows;
+        }
+        return rows - 1;
+    }
+
+    Type NextFromBag() {
+        Type result = pieceQueue[pieceQueueTop++];
+        if (pieceQueueTop >= 7) {
+            pieceQueueTop = 0;
+            for (size_t i = 0; i < 7; ++i) {
+                pieceQueue[i] = pieceQueue[i + 7];
+                pieceQueue[i + 7] = static_cast<Type>(i + 1);
+            }
+            ShuffleArray(pieceQueue + 7, 7, rng);
+        }
+        return result;
+    }
+
+    void ResetGame() {
+        for (int8_t y = 0; y < Height; ++y) {
+            for (int8_t x = 0; x < Width; ++x) {
+                board[y][x] = Type::None;
+            }
+        }
+        pieceQueueTop = 0;
+        for (size_t i = 0; i < 7; ++i) {
+            pieceQueue[i] = static_cast<Type>(i + 1);
+            pieceQueue[i + 7] = static_cast<Type>(i + 1);
+        }
+        ShuffleArray(pieceQueue, 7, rng);
+        ShuffleArray(pieceQueue + 7, 7, rng);
+        currentPiece = Tetromino{NextFromBag()};
+        holdType = Type::None;
+        alreadySwapped = false;
+        gameOver = false;
+        level = 1;
+        linesCleared = 0;
+        score = 0;
+        lastLinesCleared = 0;
+    }
+
+    void ClearLines() {
+        int cleared = 0;
+        for (int8_t y = Height - 1; y >= 0; --y) {
+            bool full = true;
+            for (int8_t x = 0; x < Width; ++x) {
+                full = full && Filled(x, y);
+            }
+            if (!full) {
+                continue;
+            }
+            for (int8_t above = y; above > 0; --above) {
+                for (int8_t x = 0; x < Width; ++x) {
+                    board[above][x] = board[above - 1][x];
+                }
+            }
+            for (int8_t x = 0; x < Width; ++x) {
+                board[0][x] = Type::None;
+            }
+            ++cleared;
+            ++y;  // The row that moved down into y needs checking too
+        }
+
+        lastLinesCleared = cleared;
+        if (cleared > 0) {
+            static const long pointsPerLine[5] = {0, 100, 300, 500, 800};
+            score += pointsPerLine[cleared] * level;
+            linesCleared += cleared;
+            int newLevel = linesCleared / 5 + 1;
+            if (newLevel > level && newLevel <= 10) {
+                level = newLevel;
+            }
+        }
+    }
+
+    // Locks the piece where it is. Any mino above the board tops out instead.
+    void PlacePiece(Tetromino& piece) {
+        for (size_t i = 0; i < 4; ++i) {
+            if (piece.GetMino(i).y < 0) {
+                gameOver = true;
+                lastLinesCleared = 0;
+                return;
+            }
+        }
+        for (size_t i = 0; i < 4; ++i) {
+            typename Tetromino::Mino mino = piece.GetMino(i);
+            board[mino.y][mino.x] = piece.type;
+        }
+        piece = Tetromino{NextFromBag()};
+        alreadySwapped = false;
+        ClearLines();
+        if (PieceHitWall(piece)) {
+            gameOver = true;
+        }
+    }
+
+    void HardDrop() {
+        currentPiece.py += DistanceFromFloor(currentPiece);
+        PlacePiece(currentPiece);
+    }
+
+    void SwapHold() {
+        if (alreadySwapped) {
+            return;
+        }
+        alreadySwapped = true;
+        if (holdType == Type::None) {
+            holdType = currentPiece.type;
+            currentPiece = Tetromino{NextFromBag()};
+        }
+        else {
+            Type oldType = currentPiece.type;
+            currentPiece = Tetromino{holdType};
+            holdType = oldType;
+        }
+    }
+
+    // `hole` must be a column of the board; a garbage row with no hole would
+    // be full, and the engine only looks for full rows where a piece lands
+    void AddGarbage(int8_t lines, int8_t hole) {
+        if (lines <= 0) {
+            return;
+        }
+        if (lines > Height) {
+            lines = Height;
+        }
+        for (int8_t y = 0; y < lines; ++y) {
+            for (int8_t x = 0; x < Width; ++x) {
+                if (Filled(x, y)) {
+                    gameOver = true;
+                }
+            }
+        }
+        for (int8_t y = 0; y < Height; ++y) {
+            for (int8_t x = 0; x < Width; ++x) {
+                if (y + lines < Height) {
+                    board[y][x] = board[y + lines][x];
+                }
+                else {
+                    board[y][x] = x == hole ? Type::None : Type::Garbage;
+                }
+            }
+        }
+        if (PieceHitWall(currentPiece)) {
+            gameOver = true;
+        }
+    }
+
+    // The engine's Zobrist hash of this position, from scratch
+    uint64_t Hash() const {
+        uint64_t hash = Game::Zobrist.current[currentPiece.type] ^ Game::Zobrist.hold[holdType] ^
+                        Game::Zobrist.queueTop[pieceQueueTop];
+        for (int8_t y = 0; y < Height; ++y) {
+            for (int8_t x = 0; x < Width; ++x) {
+                if (Filled(x, y)) {
+                    hash ^= Game::Zobrist.cell[y][x];
+                }
+            }
+        }
+        return hash;
+    }
+};
@@ -0,0 +1,262 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "platform_offscreen.hpp"
+#include "tetris.hpp"
+#include "replay.hpp"
+#include "parallel.hpp"
+
+// Renders replays to raw video without a display. The positions of a replay
+// are played out a window at a time and rasterised by the offscreen Screen
+// on a pool of workers; a writer thread
+// takes the finished frames back in order from a bounded ReorderQueue and
+// streams them out as Y4M (4:4:4) or as concatenated binary PPMs, either of
+// which ffmpeg reads from a pipe.
+
+// The board and side panel, plus two rows for the score and level
+using FrameScreen = Screen<18, 24>;
+// Smallest scale at which a line of text (7 pixels, see platform_offscreen.hpp)
+// fits in its row with a pixel to spare
+static constexpr size_t MinScale = 8;
+
+namespace Format {
+    enum Format : int {
+        Y4M = 0, PPM, COUNT,
+    };
+}
+
+struct Options {
+    Format::Format format = Format::Y4M;
+    size_t scale = 8;
+    size_t fps = 30;
+    size_t framesPerMove = 2;
+    size_t threads = DefaultThreadCount();
+};
+
+// One encoded frame, without the stream header
+static void Encode(FrameScreen const& screen, Format::Format format, std::vector<uint8_t>& out) {
+    size_t width = screen.PixelWidth();
+    size_t height = screen.PixelHeight();
+    const uint8_t* rgb = screen.Pixels();
+    size_t pixels = width * height;
+
+    if (format == Format::PPM) {
+        char header[64];
+        int length = snprintf(header, sizeof(header), "P6\n%zu %zu\n255\n", width, height);
+        out.assign(header, header + length);
+        out.insert(out.end(), rgb, rgb + pixels * 3);
+        return;
+    }
+
+    // BT.601 limited range, one plane after another
+    static constexpr char FrameTag[] = "FRAME\n";
+    out.resize(sizeof(FrameTag) - 1 + pixels * 3);
+    memcpy(out.data(), FrameTag, sizeof(FrameTag) - 1);
+    uint8_t* y = out.data() + sizeof(FrameTag) - 1;
+    uint8_t* u = y + pixels;
+    uint8_t* v = u + pixels;
+    for (size_t i = 0; i < pixels; ++i) {
+        int r = rgb[i * 3];
+        int g = rgb[i * 3 + 1];
+        int b = rgb[i * 3 + 2];
+        y[i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+}
+
+static void Rasterise(FrameScreen& screen, Tetris<> const& game, size_t scale) {
+    game.Draw(screen);
+    screen.RedrawScreen();
+    char line[32];
+    snprintf(line, sizeof(line), "SCORE %ld", game.score);
+    screen.DrawText(scale / 2, 22 * scale, line, Color::White);
+    if (game.gameOver) {
+        snprintf(line, sizeof(line), "GAME OVER");
+    }
+    else {
+        snprintf(line, sizeof(line), "LEVEL %d", game.level);
+    }
+    screen.DrawText(scale / 2, 23 * scale, line, Color::White);
+}
+
+// Returns the number of frames written, or -1 if the replay could not be read
+static long RenderReplay(const char* path, FILE* out, bool writeHeader, Options const& options,
+                         std::vector<std::unique_ptr<FrameScreen>>& screens) {
+    Replay replay;
+    if (!replay.Load(path)) {
+        return -1;
+    }
+
+    // Enough slots to keep every worker busy while the writer catches up.
+    // Positions are played out a window of this many at a time, so memory
+    // stays flat however long the replay is, and each window is big enough
+    // that starting the workers for it costs little. An empty frame ends the
+    // stream.
+    size_t window = options.threads * 16;
+    ReorderQueue<std::vector<uint8_t>> queue(window);
+    std::thread writer([&] {
+        for (bool first = true;; first = false) {
+            std::vector<uint8_t> frame = queue.Pop();
+            if (frame.empty()) {
+                break;
+            }
+            if (first && writeHeader && options.format == Format::Y4M) {
+                fprintf(out, "YUV4MPEG2 W%zu H%zu F%zu:1 Ip A1:1 C444\n",
+                        screens[0]->PixelWidth(), screens[0]->PixelHeight(), options.fps);
+            }
+            for (size_t repeat = 0; repeat < options.framesPerMove; ++repeat) {
+                fwrite(frame.data(), 1, frame.size(), out);
+            }
+        }
+    });
+
+    std::vector<Tetris<>> positions;
+    positions.reserve(window);
+    size_t rendered = 0;
+    auto RenderWindow = [&] {
+        if (positions.empty()) {
+            return;
+        }
+        ParallelFor(positions.size(), options.threads, [&](size_t index, size_t worker) {
+            FrameScreen& screen = *screens[worker];
+            Rasterise(screen, positions[index], options.scale);
+            std::vector<uint8_t> frame;
+            Encode(screen, options.format, frame);
+            queue.Push(rendered + index, std::move(frame));
+            return true;
+        });
+        rendered += positions.size();
+        positions.clear();
+    };
+    bool played = replay.Play([&](Tetris<> const& game) {
+        positions.push_back(game);
+        if (positions.size() == window) {
+            RenderWindow();
+        }
+    });
+    RenderWindow();
+    queue.Push(rendered, {});
+    writer.join();
+    return played ? static_cast<long>(rendered * options.framesPerMove) : -1;
+}
+
+
+void Usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options] REPLAY...\n"
+        "  --out F        write every replay into one stream (default: stdout)\n"
+        "  --dir D        write one file per replay into D instead\n"
+        "  --format F     y4m or ppm (default y4m)\n"
+        "  --scale N      pixels per cell, at least 8 (default 8)\n"
+        "  --fps N        frame rate in the Y4M header (default 30)\n"
+        "  --hold N       frames per move (default 2)\n"
+        "  --threads N    rasteriser threads (default: all cores)\n",
+        program);
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    const char* outPath = nullptr;
+    const char* dir = nullptr;
+    std::vector<const char*> replays;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--", 2) != 0) {
+            replays.push_back(arg);
+            continue;
+        }
+        const char* value = i+1 < argc ? argv[++i] : nullptr;
+        if (!value) {
+            Usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "--out") == 0) outPath = value;
+        else if (strcmp(arg, "--dir") == 0) dir = value;
+        else if (strcmp(arg, "--format") == 0 && strcmp(value, "y4m") == 0) options.format = Format::Y4M;
+        else if (strcmp(arg, "--format") == 0 && strcmp(value, "ppm") == 0) options.format = Format::PPM;
+        else if (strcmp(arg, "--scale") == 0) options.scale = std::max<size_t>(MinScale, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--fps") == 0) options.fps = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--hold") == 0) options.framesPerMove = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--threads") == 0) options.threads = std::max(1ull, strtoull(value, nullptr, 10));
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (replays.empty()) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<FrameScreen>> screens;
+    for (size_t i = 0; i < options.threads; ++i) {
+        screens.push_back(std::make_unique<FrameScreen>(options.scale));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    FILE* stream = nullptr;
+    if (!dir) {
+        stream = outPath ? fopen(outPath, "wb") : stdout;
+        if (!stream) {
+            fprintf(stderr, "Failed to create %s\n", outPath);
+            return 1;
+        }
+    }
+
+    long frames = 0;
+    int failures = 0;
+    // The single stream's header goes out with the first replay that renders
+    bool headerWritten = false;
+    for (size_t i = 0; i < replays.size(); ++i) {
+        FILE* out = stream;
+        std::string path;
+        if (dir) {
+            std::string name = replays[i];
+            name = name.substr(name.find_last_of("/\\") + 1);
+            name = name.substr(0, name.find_last_of('.'));
+            path = std::string(dir) + "/" + name + (options.format == Format::Y4M ? ".y4m" : ".ppm");
+            out = fopen(path.c_str(), "wb");
+            if (!out) {
+                fprintf(stderr, "Failed to create %s\n", path.c_str());
+                ++failures;
+                continue;
+            }
+        }
+        long written = RenderReplay(replays[i], out, dir || !headerWritten, options, screens);
+        if (written < 0) {
+            fprintf(stderr, "Failed to read %s\n", replays[i]);
+            ++failures;
+        }
+        else {
+            frames += written;
+        }
+        if (written > 0) {
+            headerWritten = true;
+        }
+        if (dir && fclose(out) != 0) {
+            fprintf(stderr, "Failed to write %s\n", path.c_str());
+            ++failures;
+        }
+    }
+    if (stream && stream != stdout && fclose(stream) != 0) {
+        fprintf(stderr, "Failed to write %s\n", outPath);
+        ++failures;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%ld frames from %zu replays in %.2fs (%.0f frames/s)\n",
+            frames, replays.size(), seconds, static_cast<double>(frames) / seconds);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <vector>
+
+#include "tetris.hpp"
+#include "bot.hpp"
+#include "dataset.hpp"
+#include "mapped_file.hpp"
+
+// A game saved as its seed and the placements made. The engine is
+// deterministic, so playing the moves back rebuilds every position.
+//
+// Layout, little-endian:
+//   header  "TTRSRPLY", u16 version, u8 width, u8 height, u32 move count, u64 seed
+//   moves   per move, u8 action (the dataset Actions layout) and u8 garbage:
+//           the hole column of one garbage line added after the move, or
+//           ReplayNoGarbage
+
+static constexpr uint8_t ReplayNoGarbage = 0xFF;
+
+struct ReplayMove {
+    uint8_t action;
+    uint8_t garbage = ReplayNoGarbage;
+};
+
+struct ReplayHeader {
+    char magic[8];
+    uint16_t version;
+    uint8_t width;
+    uint8_t height;
+    uint32_t count;
+    uint64_t seed;
+};
+
+static constexpr char ReplayMagic[8] = {'T', 'T', 'R', 'S', 'R', 'P', 'L', 'Y'};
+static constexpr uint16_t ReplayVersion = 1;
+
+
+struct Replay {
+    uint64_t seed = 0;
+    uint8_t width = 10;
+    uint8_t height = 20;
+    std::vector<ReplayMove> moves;
+
+    bool Save(const char* path) const {
+        TRACE_SCOPE("replay save");
+        FILE* file = fopen(path, "wb");
+        if (!file) {
+            return false;
+        }
+        ReplayHeader header{};
+        memcpy(header.magic, ReplayMagic, sizeof(header.magic));
+        header.version = ReplayVersion;
+        header.width = width;
+        header.height = height;
+        header.count = static_cast<uint32_t>(moves.size());
+        header.seed = seed;
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        ok &= fwrite(moves.data(), sizeof(moves[0]), moves.size(), file) == moves.size();
+        ok &= fclose(file) == 0;
+        return ok;
+    }
+
+    bool Load(const char* path) {
+        TRACE_SCOPE("replay load");
+        MappedFile file;
+        if (!file.Open(path) || file.size < sizeof(ReplayHeader)) {
+            return false;
+        }
+        ReplayHeader header;
+        memcpy(&header, file.data, sizeof(header));
+        if (memcmp(header.magic, ReplayMagic, sizeof(header.magic)) != 0 ||
+            header.version != ReplayVersion ||
+            sizeof(header) + header.count * sizeof(ReplayMove) != file.size) {
+            return false;
+        }
+        seed = header.seed;
+        width = header.width;
+        height = header.height;
+        moves.resize(header.count);
+        memcpy(moves.data(), file.data + sizeof(header), header.count * sizeof(ReplayMove));
+        return true;
+    }
+
+    // The placement a move makes from `game`
+    template<int8_t Width=10, int8_t Height=20>
+    static typename Bot<Width, Height>::Placement Decode(Tetris<Width, Height> const& game, ReplayMove move) {
+        using Placer = Bot<Width, Height>;
+        bool hold;
+        typename Tetris<Width, Height>::Tetromino piece;
+        UnpackAction(move.action, hold, piece.rotation, piece.px);
+        hold = hold && !game.alreadySwapped;
+        piece.type = hold ? Placer::HoldType(game) : game.currentPiece.type;
+        piece.py = typename Tetris<Width, Height>::Tetromino{piece.type}.py;
+        return {piece, hold};
+    }
+
+    // Calls fn(game) with the starting position and after every move
+    template<int8_t Width=10, int8_t Height=20>
+    bool Play(auto&& fn) const {
+        using Game = Tetris<Width, Height>;
+        using Placer = Bot<Width, Height>;
+        if (width != Width || height != Height) {
+            return false;
+        }
+        Game game(seed);
+        fn(static_cast<Game const&>(game));
+        for (ReplayMove const& move : moves) {
+            if (game.gameOver) {
+                break;
+            }
+            Placer::Apply(game, Decode(game, move));
+            if (move.garbage != ReplayNoGarbage) {
+                game.AddGarbage(1, static_cast<int8_t>(move.garbage));
+            }
+            fn(static_cast<Game const&>(game));
+        }
+        return true;
+    }
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstdint>
+
+// splitmix64: advances `state` and returns a well-mixed 64-bit value. Used
+// for the Zobrist keys, per-job seeds and anything else that needs cheap,
+// reproducible randomness.
+constexpr uint64_t SplitMix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
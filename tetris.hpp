@@ -0,0 +1,901 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+#include <cstdlib>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <type_traits>
+
+#include "platform.hpp"
+#include "splitmix.hpp"
+
+using namespace std::chrono_literals;
+
+
+#define UNREACHABLE assert(0 && "Unreachable")
+
+void ShuffleArray(auto* arr, size_t N, auto& rng) {
+    for (size_t i = N-1; i >= 1; --i) {
+        size_t j = static_cast<size_t>(rng() % (i+1));
+        std::swap(arr[i], arr[j]);
+    }
+}
+
+
+// Smallest unsigned word that holds one row of a Width-wide board as a bitmask
+template<int8_t Width>
+using RowWord =
+    std::conditional_t<Width <= 8, uint8_t,
+    std::conditional_t<Width <= 16, uint16_t,
+    std::conditional_t<Width <= 32, uint32_t, uint64_t>>>;
+
+
+template<int8_t Width=10, int8_t Height=20>
+struct Tetris {
+    static_assert(Width >= 4 && Width <= 64, "rows are stored as one word of at most 64 bits");
+
+    using Row = RowWord<Width>;
+    static constexpr Row FullRow = static_cast<Row>(static_cast<Row>(~Row{0}) >> (sizeof(Row) * 8 - Width));
+
+    static constexpr auto DAS = std::chrono::system_clock::duration(133ms).count();
+    static constexpr auto ARR = std::chrono::system_clock::duration(10ms).count();
+    static constexpr auto LOCK_DELAY = std::chrono::system_clock::duration(500ms).count(); // 0.5 seconds before locking
+    static constexpr auto INITIAL_FALL_INTERVAL = std::chrono::system_clock::duration(1000ms).count(); // 1 second initially
+    static constexpr auto MIN_FALL_INTERVAL = std::chrono::system_clock::duration(100ms).count(); // Maximum speed (10 blocks/sec)
+    static constexpr auto TIME_TO_MAX_SPEED = std::chrono::system_clock::duration(180000ms).count(); // 3 minutes to reach max speed
+    bool alreadySwapped = false;
+    bool gameOver = false;
+    timepoint gameStartTime;
+    int level = 1;  // New: Current level (starts at 1, max 10)
+    int linesCleared = 0;  // New: Total lines cleared for level progression
+    long score = 0;  // New: Player's score
+    int lastLinesCleared = 0;  // Lines cleared by the most recent placement
+
+    struct Tetromino {
+        struct Mino {
+            int8_t x, y;
+        };
+
+        enum Type : uint8_t {
+            None = 0, I, J, L, O, S, T, Z, Garbage
+        };
+
+        Type type;
+        int8_t rotation = 0;
+        int8_t px = Width / 2 - 1;
+        int8_t py = 0;
+
+        // rotations[type][rotation][mino]
+        static constexpr Mino rotations[][4][4] = {
+            [Type::I] = {
+                { {-1, 0}, { 0, 0}, {+1, 0}, {+2, 0} },
+                { { 0,-1}, { 0, 0}, { 0,+1}, { 0,+2} },
+                { {+1, 0}, { 0, 0}, {-1, 0}, {-2, 0} },
+                { { 0,+1}, { 0, 0}, { 0,-1}, { 0,-2} },
+            },
+            [Type::J] = {
+                { {-1,-1}, {-1, 0}, { 0, 0}, {+1, 0} },
+                { {+1,-1}, { 0,-1}, { 0, 0}, { 0,+1} },
+                { {+1,+1}, {+1, 0}, { 0, 0}, {-1, 0} },
+                { {-1,+1}, { 0,+1}, { 0, 0}, { 0,-1} },
+            },
+            [Type::L] = {
+                { {+1,-1}, {-1, 0}, { 0, 0}, {+1, 0} },
+                { {+1,+1}, { 0,-1}, { 0, 0}, { 0,+1} },
+                { {-1,+1}, {+1, 0}, { 0, 0}, {-1, 0} },
+                { {-1,-1}, { 0,+1}, { 0, 0}, { 0,-1} },
+            },
+            [Type::O] = {
+                { { 0, 0}, { 0,-1}, {+1, 0}, {+1,-1} },
+                { { 0, 0}, {+1, 0}, { 0,+1}, {+1,+1} },
+                { { 0, 0}, { 0,+1}, {-1, 0}, {-1,+1} },
+                { { 0, 0}, {-1, 0}, { 0,-1}, {-1,-1} },
+            },
+            [Type::S] = {
+                { {-1, 0}, { 0, 0}, { 0,-1}, {+1,-1} },
+                { { 0,-1}, { 0, 0}, {+1, 0}, {+1,+1} },
+                { {+1, 0}, { 0, 0}, { 0,+1}, {-1,+1} },
+                { { 0,+1}, { 0, 0}, {-1, 0}, {-1,-1} },
+            },
+            [Type::T] = {
+                { { 0, 0}, {-1, 0}, { 0,-1}, {+1, 0} },
+                { { 0, 0}, { 0,-1}, {+1, 0}, { 0,+1} },
+                { { 0, 0}, {+1, 0}, { 0,+1}, {-1, 0} },
+                { { 0, 0}, { 0,+1}, {-1, 0}, { 0,-1} },
+            },
+            [Type::Z] = {
+                { {-1,-1}, { 0,-1}, { 0, 0}, {+1, 0} },
+                { {+1,-1}, {+1, 0}, { 0, 0}, { 0,+1} },
+                { {+1,+1}, { 0,+1}, { 0, 0}, {-1, 0} },
+                { {-1,+1}, {-1, 0}, { 0, 0}, { 0,-1} },
+            },
+        };
+
+        // offsets[rotation][offset]
+        static constexpr Mino JLSTZoffsets[4][5] {
+            { { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0} },
+            { { 0, 0}, {+1, 0}, {+1,+1}, { 0,-2}, {+1,-2} },
+            { { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0} },
+            { { 0, 0}, {-1, 0}, {-1,+1}, { 0,-2}, {-1,-2} },
+        };
+        static constexpr Mino Ioffsets[4][5] {
+            { { 0, 0}, {-1, 0}, {+2, 0}, {-1, 0}, {+2, 0} },
+            { {-1, 0}, { 0, 0}, { 0, 0}, { 0,-1}, { 0,+2} },
+            { {-1,-1}, {+1,-1}, {-2,-1}, {+1, 0}, {-2, 0} },
+            { { 0,-1}, { 0,-1}, { 0,-1}, { 0,+1}, { 0,-2} },
+        };
+        static constexpr Mino Ooffsets[4][5] {
+            { { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0}, { 0, 0} },
+            { { 0,+1}, { 0,+1}, { 0,+1}, { 0,+1}, { 0,+1} },
+            { {-1,+1}, {-1,+1}, {-1,+1}, {-1,+1}, {-1,+1} },
+            { {-1, 0}, {-1, 0}, {-1, 0}, {-1, 0}, {-1, 0} },
+        };
+
+        Mino GetMino(size_t i) const {
+            Mino mino{px, py};
+            Mino diff = rotations[type][rotation][i];
+            mino.x += diff.x;
+            mino.y += diff.y;
+            return mino;
+        }
+
+    };
+
+    // Zobrist keys for the position hash: one per filled cell, plus the type
+    // in play, the held type and the offset into the piece queue
+    struct ZobristKeys {
+        uint64_t cell[Height][Width];
+        uint64_t current[Tetromino::Type::Garbage + 1];
+        uint64_t hold[Tetromino::Type::Garbage + 1];
+        uint64_t queueTop[7];
+    };
+
+    static constexpr ZobristKeys Zobrist = [] {
+        ZobristKeys keys{};
+        uint64_t state = 0x7E7215;
+        for (auto& row : keys.cell) {
+            for (uint64_t& key : row) {
+                key = SplitMix64(state);
+            }
+        }
+        for (uint64_t& key : keys.current) {
+            key = SplitMix64(state);
+        }
+        for (uint64_t& key : keys.hold) {
+            key = SplitMix64(state);
+        }
+        for (uint64_t& key : keys.queueTop) {
+            key = SplitMix64(state);
+        }
+        return keys;
+    }();
+
+    uint64_t PieceKeys() const {
+        return Zobrist.current[currentPiece.type] ^ Zobrist.hold[holdType] ^ Zobrist.queueTop[pieceQueueTop];
+    }
+
+    // From scratch; `hash` is kept up to date as the game changes
+    uint64_t ComputeHash() const {
+        uint64_t result = PieceKeys();
+        for (int8_t y = 0; y < Height; ++y) {
+            result ^= RowKeys(y);
+        }
+        return result;
+    }
+
+    // All board writes go through here to keep the hash, the row masks and
+    // the column tops up to date
+    void SetCell(int8_t x, int8_t y, Tetromino::Type type) {
+        bool wasFilled = board[y][x] != Tetromino::Type::None;
+        bool filled = type != Tetromino::Type::None;
+        board[y][x] = type;
+        if (wasFilled == filled) {
+            return;
+        }
+        hash ^= Zobrist.cell[y][x];
+        rowBits[y] ^= static_cast<Row>(Row{1} << x);
+        if (filled) {
+            if (y < columnTop[x]) {
+                columnTop[x] = y;
+            }
+        }
+        else {
+            if (y == columnTop[x]) {
+                int8_t top = y + 1;
+                while (top < Height && board[top][x] == Tetromino::Type::None) {
+                    ++top;
+                }
+                columnTop[x] = top;
+            }
+        }
+    }
+
+    static_assert(Tetromino::Type::Garbage < Palette::White, "piece types double as palette indices");
+
+    bool InBounds(int8_t x, int8_t y) const {
+        // NOTE: Don't check for y >= 0 here
+        return y < Height && x >= 0 && x < Width;
+    }
+
+    bool HitWall(int8_t x, int8_t y) const {
+        return !InBounds(x, y) ||
+            (y >= 0 && (rowBits[y] >> x & 1));
+    }
+
+    // A piece's cells as one mask per row it covers, for a type, rotation and
+    // column. Built for every column a piece can be in, so collision tests are
+    // a few word ANDs however wide the board is.
+    struct PieceMask {
+        int8_t top;  // First row covered, relative to py
+        int8_t rows;
+        bool outside;  // Some mino is off the side of the board
+        Row row[4];
+    };
+
+    // PieceMasks[type][rotation][px]. Every mino offset is within 2 of the
+    // centre and some is at dx >= 0, so a piece is never in bounds with px < 0.
+    static constexpr auto PieceMasks = [] {
+        std::array<std::array<std::array<PieceMask, Width>, 4>, Tetromino::Type::Z + 1> masks{};
+        for (size_t type = Tetromino::Type::I; type <= Tetromino::Type::Z; ++type) {
+            for (size_t rotation = 0; rotation < 4; ++rotation) {
+                int8_t top = 2;
+                int8_t bottom = -2;
+                for (typename Tetromino::Mino mino : Tetromino::rotations[type][rotation]) {
+                    top = std::min(top, mino.y);
+                    bottom = std::max(bottom, mino.y);
+                }
+                for (int8_t px = 0; px < Width; ++px) {
+                    PieceMask& mask = masks[type][rotation][px];
+                    mask.top = top;
+                    mask.rows = bottom - top + 1;
+                    for (typename Tetromino::Mino mino : Tetromino::rotations[type][rotation]) {
+                        int8_t x = px + mino.x;
+                        if (x < 0 || x >= Width) {
+                            mask.outside = true;
+                        }
+                        else {
+                            mask.row[mino.y - top] |= static_cast<Row>(Row{1} << x);
+                        }
+                    }
+                }
+            }
+        }
+        return masks;
+    }();
+
+    bool PieceHitWall(Tetromino piece, int8_t dx = 0, int8_t dy = 0) const {
+        int x = piece.px + dx;
+        if (x < 0 || x >= Width) {
+            return true;
+        }
+        PieceMask const& mask = PieceMasks[piece.type][piece.rotation][x];
+        int y = piece.py + dy + mask.top;
+        if (mask.outside || y + mask.rows > Height) {
+            return true;
+        }
+        for (int8_t r = 0; r < mask.rows; ++r, ++y) {
+            if (y >= 0 && (rowBits[y] & mask.row[r])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // https://tetris.wiki/Super_Rotation_System
+    // Each rotation state has five offsets; a kick test is the old state's
+    // offset minus the new one's, with positive y downwards as on our board.
+    // Kicks[type][rotation][clockwise] resolves the five tests for rotating
+    // out of `rotation`, so Rotate only has to try them in order.
+    static constexpr auto Kicks = [] {
+        using Mino = typename Tetromino::Mino;
+        std::array<std::array<std::array<std::array<Mino, 5>, 2>, 4>, Tetromino::Type::Z + 1> kicks{};
+        for (size_t type = Tetromino::Type::I; type <= Tetromino::Type::Z; ++type) {
+            Mino const (*offsets)[5] =
+                type == Tetromino::Type::I ? Tetromino::Ioffsets :
+                type == Tetromino::Type::O ? Tetromino::Ooffsets :
+                Tetromino::JLSTZoffsets;
+            for (size_t rotation = 0; rotation < 4; ++rotation) {
+                for (size_t clockwise = 0; clockwise < 2; ++clockwise) {
+                    size_t next = (rotation + (clockwise ? 1 : 3)) % 4;
+                    for (size_t test = 0; test < 5; ++test) {
+                        kicks[type][rotation][clockwise][test] = {
+                            static_cast<int8_t>(offsets[rotation][test].x - offsets[next][test].x),
+                            static_cast<int8_t>(offsets[rotation][test].y - offsets[next][test].y),
+                        };
+                    }
+                }
+            }
+        }
+        return kicks;
+    }();
+
+    void Rotate(Tetromino& piece, bool clockwise) const {
+        int8_t oldRotation = piece.rotation;
+        piece.rotation = (oldRotation + (clockwise ? 1 : 3)) & 3;
+        for (typename Tetromino::Mino kick : Kicks[piece.type][oldRotation][clockwise]) {
+            if (!PieceHitWall(piece, kick.x, kick.y)) {
+                piece.px += kick.x;
+                piece.py += kick.y;
+                return;
+            }
+        }
+        piece.rotation = oldRotation;
+    }
+
+    // Lowest mino of each column a piece covers, relative to its centre
+    struct BottomProfile {
+        int8_t columns;
+        int8_t dx[4];
+        int8_t bottom[4];
+    };
+
+    // profiles[type][rotation]
+    static constexpr auto BottomProfiles = [] {
+        std::array<std::array<BottomProfile, 4>, Tetromino::Type::Z + 1> profiles{};
+        for (size_t type = Tetromino::Type::I; type <= Tetromino::Type::Z; ++type) {
+            for (size_t rotation = 0; rotation < 4; ++rotation) {
+                BottomProfile& profile = profiles[type][rotation];
+                for (typename Tetromino::Mino mino : Tetromino::rotations[type][rotation]) {
+                    int8_t c = 0;
+                    while (c < profile.columns && profile.dx[c] != mino.x) {
+                        ++c;
+                    }
+                    if (c == profile.columns) {
+                        profile.dx[c] = mino.x;
+                        profile.bottom[c] = mino.y;
+                        ++profile.columns;
+                    }
+                    else if (mino.y > profile.bottom[c]) {
+                        profile.bottom[c] = mino.y;
+                    }
+                }
+            }
+        }
+        return profiles;
+    }();
+
+    int8_t DistanceFromFloor(Tetromino piece) const {
+        // Constant time when the piece is above the surface of every column
+        // it covers; tucked under an overhang it has to be walked down.
+        BottomProfile const& profile = BottomProfiles[piece.type][piece.rotation];
+        int8_t distance = INT8_MAX;
+        bool aboveSurface = true;
+        for (int8_t c = 0; c < profile.columns; ++c) {
+            int8_t x = piece.px + profile.dx[c];
+            int8_t y = piece.py + profile.bottom[c];
+            if (x < 0 || x >= Width || y >= columnTop[x]) {
+                aboveSurface = false;
+                break;
+            }
+            distance = std::min<int8_t>(distance, columnTop[x] - 1 - y);
+        }
+        if (aboveSurface) {
+            return distance;
+        }
+
+        int8_t dy = 0;
+        while (!PieceHitWall(piece, 0, dy)) {
+            dy += 1;
+        }
+        dy -= 1;
+        return dy;
+    }
+
+    void PlacePiece(Tetromino& piece) {
+        TRACE_SCOPE_VALUE("PlacePiece", piece.type);
+        ++version;
+        // Check for game over - if any part of the piece is above the board
+        for (size_t i = 0; i < 4; ++i) {
+            int8_t y = piece.GetMino(i).y;
+            if (y < 0) {
+                gameOver = true;
+                lastLinesCleared = 0;
+                return;
+            }
+        }
+
+        int8_t top = Height-1;
+        int8_t bottom = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            int8_t x = piece.GetMino(i).x;
+            int8_t y = piece.GetMino(i).y;
+            if (y >= 0 && InBounds(x, y)) {
+                SetCell(x, y, piece.type);
+                top = std::min(top, y);
+                bottom = std::max(bottom, y);
+            }
+        }
+        hash ^= PieceKeys();
+        piece = Tetromino{NextFromBag()};
+        alreadySwapped = false;
+        hash ^= PieceKeys();
+        ClearLines(top, bottom);
+
+        // Block out - the new piece spawned on top of the stack
+        if (PieceHitWall(piece)) {
+            gameOver = true;
+        }
+    }
+
+    void ResetGame() {
+        // Clear the board
+        for (int8_t y = 0; y < Height; ++y) {
+            for (int8_t x = 0; x < Width; ++x) {
+                board[y][x] = Tetromino::Type::None;
+            }
+            rowBits[y] = 0;
+        }
+        for (int8_t x = 0; x < Width; ++x) {
+            columnTop[x] = Height;
+        }
+
+        // Reset piece queue
+        pieceQueueTop = 0;
+        for (size_t i = 0; i < 7; ++i) {
+            pieceQueue[i] = static_cast<Tetromino::Type>(i+1);
+        }
+        for (size_t i = 7; i < 14; ++i) {
+            pieceQueue[i] = static_cast<Tetromino::Type>(i-7+1);
+        }
+        ShuffleArray(pieceQueue, 7, rng);
+        ShuffleArray(pieceQueue+7, 7, rng);
+
+        // Reset current piece and hold
+        currentPiece = Tetromino{NextFromBag()};
+        holdType = Tetromino::Type::None;
+        alreadySwapped = false;
+        gameOver = false;
+        gameStartTime = std::chrono::system_clock::now().time_since_epoch().count();
+        level = 1;  // New: Reset level
+        linesCleared = 0;  // New: Reset lines cleared
+        score = 0;  // New: Reset score
+        lastLinesCleared = 0;
+        hash = ComputeHash();
+        ++version;
+    }
+
+    void SwapHold() {
+        if (alreadySwapped) {
+            return;
+        }
+        alreadySwapped = true;
+        ++version;
+        hash ^= PieceKeys();
+        if (holdType == Tetromino::Type::None) {
+            holdType = currentPiece.type;
+            currentPiece = Tetromino{NextFromBag()};
+        }
+        else {
+            typename Tetromino::Type oldType = currentPiece.type;
+            currentPiece = Tetromino{holdType};
+            holdType = oldType;
+        }
+        hash ^= PieceKeys();
+    }
+
+    void HardDrop() {
+        currentPiece.py += DistanceFromFloor(currentPiece);
+        PlacePiece(currentPiece);
+    }
+
+
+    // Push the stack up by `lines` rows of garbage with a single open column.
+    // Tops out if filled cells would be pushed off the board.
+    void AddGarbage(int8_t lines, int8_t hole) {
+        if (lines <= 0) {
+            return;
+        }
+        if (lines > Height) {
+            lines = Height;
+        }
+        ++version;
+        for (int8_t y = 0; y < lines; ++y) {
+            for (int8_t x = 0; x < Width; ++x) {
+                if (board[y][x] != Tetromino::Type::None) {
+                    gameOver = true;
+                }
+            }
+        }
+        for (int8_t y = 0; y < Height - lines; ++y) {
+            for (int8_t x = 0; x < Width; ++x) {
+                SetCell(x, y, board[y+lines][x]);
+            }
+        }
+        for (int8_t y = Height - lines; y < Height; ++y) {
+            for (int8_t x = 0; x < Width; ++x) {
+                SetCell(x, y, x == hole ? Tetromino::Type::None : Tetromino::Type::Garbage);
+            }
+        }
+        if (PieceHitWall(currentPiece)) {
+            gameOver = true;
+        }
+    }
+
+    uint64_t RowKeys(int8_t y) const {
+        uint64_t keys = 0;
+        for (Row bits = rowBits[y]; bits; bits &= bits - 1) {
+            keys ^= Zobrist.cell[y][std::countr_zero(bits)];
+        }
+        return keys;
+    }
+
+    // Clears the full rows between top and bottom (the rows the last placement
+    // touched) and compacts the rest of the stack down in one pass
+    void ClearLines(int8_t top = 0, int8_t bottom = Height-1) {
+        TRACE_SCOPE("ClearLines");
+        int linesThisTime = 0;  // New: Count lines cleared in this placement
+        int8_t fullRows[Height];  // Bottom to top
+        for (int8_t y = bottom; y >= top; --y) {
+            if (rowBits[y] == FullRow) {
+                fullRows[linesThisTime++] = y;
+            }
+        }
+
+        if (linesThisTime > 0) {
+            int8_t stackTop = *std::min_element(columnTop, columnTop + Width);
+            int8_t lowest = fullRows[0];
+            // Every filled cell from the top of the stack down to the lowest
+            // cleared row changes position, so rehash those rows
+            for (int8_t y = stackTop; y <= lowest; ++y) {
+                hash ^= RowKeys(y);
+            }
+
+            // Each span of rows between two full ones moves down by the number
+            // of full rows beneath it. Going bottom up never overwrites a span
+            // that has yet to move.
+            for (int i = 0; i < linesThisTime; ++i) {
+                int8_t spanTop = i+1 < linesThisTime ? fullRows[i+1] + 1 : stackTop;
+                int8_t spanBottom = fullRows[i] - 1;
+                if (spanTop > spanBottom) {
+                    continue;
+                }
+                size_t rows = static_cast<size_t>(spanBottom - spanTop + 1);
+                memmove(board[spanTop + i + 1], board[spanTop], rows * sizeof(board[0]));
+                memmove(rowBits + spanTop + i + 1, rowBits + spanTop, rows * sizeof(rowBits[0]));
+            }
+            for (int8_t y = stackTop; y < stackTop + linesThisTime; ++y) {
+                memset(board[y], Tetromino::Type::None, sizeof(board[0]));
+                rowBits[y] = 0;
+            }
+
+            for (int8_t y = stackTop; y <= lowest; ++y) {
+                hash ^= RowKeys(y);
+            }
+            // Cells only moved down, so each top can only have moved down
+            for (int8_t x = 0; x < Width; ++x) {
+                int8_t y = columnTop[x];
+                if (y > lowest) {
+                    continue;
+                }
+                while (y < Height && board[y][x] == Tetromino::Type::None) {
+                    ++y;
+                }
+                columnTop[x] = y;
+            }
+        }
+
+        lastLinesCleared = linesThisTime;
+        if (linesThisTime > 0) {
+            TRACE_INSTANT("line clear", linesThisTime);
+        }
+        // New: After checking all rows, update score and level if lines were cleared
+        if (linesThisTime > 0) {
+            static const long pointsPerLine[5] = {0, 100, 300, 500, 800};  // 0-index unused; matches your spec
+            score += pointsPerLine[linesThisTime] * level;  // Award points based on lines cleared at once
+            linesCleared += linesThisTime;  // Track total lines for level progression
+            int newLevel = linesCleared / 5 + 1;  // Level up every 5 lines
+            if (newLevel > level && newLevel <= 10) {
+                level = newLevel;  // Cap at level 10
+            }
+        }
+    }
+
+    Tetromino::Type NextFromBag() {
+        typename Tetromino::Type result = pieceQueue[pieceQueueTop++];
+        if (pieceQueueTop >= 7) {
+            pieceQueueTop = 0;
+            memcpy(pieceQueue, pieceQueue+7, 7*sizeof(pieceQueue[0]));
+            for (size_t i = 7; i < 14; ++i) {
+                pieceQueue[i] = static_cast<Tetromino::Type>(i-7+1);
+            }
+            ShuffleArray(pieceQueue+7, 7, rng);
+        }
+        return result;
+    }
+
+    Tetris() : Tetris(std::random_device{}()) {}
+
+    // Seeded games draw the same piece sequence every time
+    explicit Tetris(uint64_t seed)
+        : rng(static_cast<uint32_t>(seed ^ (seed >> 32)))
+    {
+        ResetGame();
+    }
+
+    // Time between gravity steps at the current level
+    timepoint FallInterval() const {
+        return INITIAL_FALL_INTERVAL - ((INITIAL_FALL_INTERVAL - MIN_FALL_INTERVAL) * (level - 1) / 9);
+    }
+
+    // Returns when Update next has something to do if no key changes: the
+    // next gravity step, the lock delay running out, or the next repeat while
+    // Left, Right or Down is held. Callers can sleep until then or until the
+    // next input, whichever comes first.
+    static constexpr timepoint Never = std::numeric_limits<timepoint>::max();
+
+    timepoint Update(timepoint now) {
+        static timepoint lastUpdate = 0;
+        static timepoint lastFall = 0;
+        static timepoint lastMoved = 0;
+        static int8_t lastPieceX = -1;
+        static int8_t lastPieceY = -1;
+        Tetromino before = currentPiece;
+
+        if (gameOver) {
+            // Check for restart
+            bool restart = IsKeyPressed(KeyPress::r);
+            static bool restartLatch = false;
+            bool restartFirstPress = false;
+            if (restart && !restartLatch) {
+                restartLatch = true;
+                restartFirstPress = true;
+            } else if (!restart) {
+                restartLatch = false;
+            }
+
+            if (restartFirstPress) {
+                ResetGame();
+                lastFall = now;
+                lastMoved = now;
+                return now + ARR;
+            }
+            return Never;
+        }
+
+        if (lastUpdate + ARR <= now) {
+            lastUpdate = now;
+        } else {
+            return lastUpdate + ARR;
+        }
+
+        // Check if piece has moved
+        if (lastPieceX != currentPiece.px || lastPieceY != currentPiece.py) {
+            lastMoved = now;
+            lastPieceX = currentPiece.px;
+            lastPieceY = currentPiece.py;
+        }
+
+        // Auto-fall logic
+        if (now - lastFall >= FallInterval()) {
+            lastFall = now;
+            if (!PieceHitWall(currentPiece, 0, 1)) {
+                currentPiece.py += 1;
+                lastMoved = now; // Reset the lock timer when falling
+                lastPieceY = currentPiece.py;
+            }
+        }
+
+        // Lock delay - if piece hasn't moved for LOCK_DELAY and is on the ground
+        if (PieceHitWall(currentPiece, 0, 1) && now - lastMoved >= LOCK_DELAY) {
+            TRACE_INSTANT("lock delay expired", currentPiece.type);
+            PlacePiece(currentPiece);
+            lastMoved = now;
+            lastPieceX = currentPiece.px;
+            lastPieceY = currentPiece.py;
+            lastFall = now;
+        }
+
+        static bool holdLatch = false;
+        static bool dropLatch = false;
+        static bool leftLatch = false;
+        static bool rightLatch = false;
+        static bool upLatch = false;
+        static bool zLatch = false;
+
+        bool right = IsKeyPressed(KeyPress::Right);
+        bool rightDAS = right && lastPress[KeyPress::Right] + DAS < now;
+        bool rightFirstPress = false;
+        if (right && !rightLatch) {
+            rightLatch = true;
+            rightFirstPress = true;
+        }
+        else if (!right) {
+            rightLatch = false;
+        }
+        bool rightPress = rightFirstPress || rightDAS;
+
+        bool left = IsKeyPressed(KeyPress::Left);
+        bool leftDAS = left && lastPress[KeyPress::Left] + DAS < now;
+        bool leftFirstPress = false;
+        if (left && !leftLatch) {
+            leftLatch = true;
+            leftFirstPress = true;
+        }
+        else if (!left) {
+            leftLatch = false;
+        }
+        bool leftPress = leftFirstPress || leftDAS;
+
+
+        bool up = IsKeyPressed(KeyPress::Up);
+        bool upFirstPress = false;
+        if (up && !upLatch) {
+            upLatch = true;
+            upFirstPress = true;
+        }
+        else if (!up) {
+            upLatch = false;
+        }
+
+        bool z = IsKeyPressed(KeyPress::z);
+        bool zFirstPress = false;
+        if (z && !zLatch) {
+            zLatch = true;
+            zFirstPress = true;
+        }
+        else if (!z) {
+            zLatch = false;
+        }
+
+        bool downPress = IsKeyPressed(KeyPress::Down);
+
+        bool hold = IsKeyPressed(KeyPress::c);
+        bool holdFirstPress = false;
+        if (hold && !holdLatch) {
+            holdLatch = true;
+            holdFirstPress = true;
+        }
+        else if (!hold) {
+            holdLatch = false;
+        }
+
+        bool drop = IsKeyPressed(KeyPress::Space);
+        bool dropFirstPress = false;
+        if (drop && !dropLatch) {
+            dropLatch = true;
+            dropFirstPress = true;
+        }
+        else if (!drop) {
+            dropLatch = false;
+        }
+
+
+        if (upFirstPress) {
+            Rotate(currentPiece, true);
+            if (lastPieceX != currentPiece.px || lastPieceY != currentPiece.py) {
+                lastMoved = now;
+                lastPieceX = currentPiece.px;
+                lastPieceY = currentPiece.py;
+            }
+        }
+        if (zFirstPress) {
+            Rotate(currentPiece, false);
+            if (lastPieceX != currentPiece.px || lastPieceY != currentPiece.py) {
+                lastMoved = now;
+                lastPieceX = currentPiece.px;
+                lastPieceY = currentPiece.py;
+            }
+        }
+
+        if (holdFirstPress) {
+            SwapHold();
+            lastMoved = now;
+            lastPieceX = currentPiece.px;
+            lastPieceY = currentPiece.py;
+        }
+
+        if (dropFirstPress) {
+            HardDrop();
+            // The new piece gets a whole fall interval, as after a lock
+            lastFall = now;
+            lastMoved = now;
+            lastPieceX = currentPiece.px;
+            lastPieceY = currentPiece.py;
+        }
+
+        int8_t dx = rightPress - leftPress;
+        int8_t dy = downPress;
+        if (!PieceHitWall(currentPiece, dx, 0)) {
+            currentPiece.px += dx;
+            if (dx != 0) {
+                lastMoved = now;
+                lastPieceX = currentPiece.px;
+            }
+        }
+        if (!PieceHitWall(currentPiece, 0, dy)) {
+            currentPiece.py += dy;
+            if (dy != 0) {
+                lastMoved = now;
+                lastPieceY = currentPiece.py;
+            }
+        }
+
+        if (currentPiece.px != before.px || currentPiece.py != before.py || currentPiece.rotation != before.rotation) {
+            ++version;
+        }
+
+        if (gameOver) {
+            return Never;
+        }
+        // The level may have gone up with this update's line clears
+        timepoint next = lastFall + FallInterval();
+        if (PieceHitWall(currentPiece, 0, 1)) {
+            next = std::min(next, lastMoved + LOCK_DELAY);
+        }
+        if (left || right || downPress) {
+            next = std::min(next, now + ARR);
+        }
+        return std::max(next, lastUpdate + ARR);
+    }
+
+    template<typename ScreenT>
+    void DrawPiece(ScreenT& screen, Tetromino piece, uint8_t index, int8_t dx, int8_t dy) const {
+        if (piece.type == Tetromino::Type::None) {
+            return;
+        }
+
+        for (size_t i = 0; i < 4; ++i) {
+            int8_t minoX = piece.GetMino(i).x + dx;
+            int8_t minoY = piece.GetMino(i).y + dy;
+            screen.SetPixel(static_cast<size_t>(minoX), static_cast<size_t>(minoY), index);
+        }
+    }
+
+    template<typename ScreenT>
+    void Draw(ScreenT& screen) const {
+        screen.ClearBuffer();
+        for (size_t y = 0; y <= Height+1; ++y) {
+            screen.SetPixel(0, y, Palette::White);
+            screen.SetPixel(Width+1, y, Palette::White);
+        }
+        for (size_t x = 0; x <= Width+1; ++x) {
+            screen.SetPixel(x, 0, Palette::White);
+            screen.SetPixel(x, Height+1, Palette::White);
+        }
+        for (size_t y = 0; y < Height; ++y) {
+            for (size_t x = 0; x < Width; ++x) {
+                screen.SetPixel(x+1, y+1, board[y][x]);
+            }
+        }
+
+        // Next piece queue
+        for (int8_t top = 0; top < 5; ++top) {
+            Tetromino nextPiece{.type=pieceQueue[pieceQueueTop+static_cast<size_t>(top)], .rotation=0, .px=0, .py=0};
+            DrawPiece(screen, nextPiece, nextPiece.type, Width + 4, 2 + top * 3);
+        }
+
+        // Hold piece
+        Tetromino holdPiece{.type=holdType, .rotation=0, .px=0, .py=0};
+        DrawPiece(screen, holdPiece, holdPiece.type, Width + 4, Height);
+
+        if (!gameOver) {
+            // Ghost piece
+            int8_t distFromFloor = DistanceFromFloor(currentPiece);
+            DrawPiece(screen, currentPiece, currentPiece.type | Palette::Ghost, 1, 1 + distFromFloor);
+
+            // Current piece
+            DrawPiece(screen, currentPiece, currentPiece.type, 1, 1);
+        }
+    }
+
+    std::minstd_rand rng;
+    size_t pieceQueueTop;
+    Tetromino::Type pieceQueue[14];
+    Tetromino::Type board[Height][Width]{};
+    Row rowBits[Height]{};  // Filled cells per row, bit x for column x
+    int8_t columnTop[Width]{};  // Highest filled row per column, Height if empty
+    Tetromino currentPiece;
+    Tetromino::Type holdType = Tetromino::Type::None;
+    // Zobrist hash of the board, current piece, hold and queue offset
+    uint64_t hash = 0;
+    // Advances whenever something that Draw shows changes
+    uint64_t version = 0;
+};
@@ -0,0 +1,185 @@
+#include <cstdint>
+#include <cstring>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tetris.hpp"
+#include "bot.hpp"
+#include "parallel.hpp"
+#include "tetris_env.h"
+
+// Shared library behind tetris_env.h. Games are stepped in contiguous slices,
+// one per thread, by a pool that lives as long as the environment so a step
+// never allocates or spawns anything.
+
+using Game = Tetris<TETRIS_ENV_WIDTH, TETRIS_ENV_HEIGHT>;
+using Tetromino = Game::Tetromino;
+
+struct TetrisEnv {
+    std::vector<Game> games;
+    std::vector<uint64_t> episodes;
+    uint64_t seed;
+
+    // Arguments of the step in flight
+    const int32_t* actions = nullptr;
+    uint8_t* observations = nullptr;
+    float* rewards = nullptr;
+    uint8_t* dones = nullptr;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    uint64_t generation = 0;
+    size_t busy = 0;
+    bool quit = false;
+};
+
+static uint64_t EpisodeSeed(TetrisEnv const* env, size_t i) {
+    return DeriveSeed(DeriveSeed(env->seed, i), env->episodes[i]);
+}
+
+static void Observe(Game const& game, uint8_t* obs) {
+    for (int8_t y = 0; y < TETRIS_ENV_HEIGHT; ++y) {
+        for (int8_t x = 0; x < TETRIS_ENV_WIDTH; ++x) {
+            *obs++ = game.board[y][x] != Tetromino::Type::None;
+        }
+    }
+    *obs++ = game.currentPiece.type;
+    *obs++ = game.holdType;
+    for (size_t i = 0; i < TETRIS_ENV_QUEUE; ++i) {
+        *obs++ = game.pieceQueue[game.pieceQueueTop + i];
+    }
+}
+
+static void StepGame(TetrisEnv* env, size_t i) {
+    Game& game = env->games[i];
+    int32_t action = env->actions[i];
+    if (action < 0 || action >= TETRIS_ENV_ACTIONS) {
+        action = 0;
+    }
+    bool hold = action / (TETRIS_ENV_ROTATIONS * TETRIS_ENV_COLUMNS) != 0 && !game.alreadySwapped;
+    int32_t rotation = action / TETRIS_ENV_COLUMNS % TETRIS_ENV_ROTATIONS;
+    int32_t column = action % TETRIS_ENV_COLUMNS;
+
+    Tetromino piece{hold ? Bot<TETRIS_ENV_WIDTH, TETRIS_ENV_HEIGHT>::HoldType(game) : game.currentPiece.type};
+    piece.rotation = static_cast<int8_t>(rotation);
+    piece.px = static_cast<int8_t>(column - 2);
+    if (!Bot<TETRIS_ENV_WIDTH, TETRIS_ENV_HEIGHT>::Reachable(game, piece)) {
+        piece = Tetromino{piece.type};
+    }
+
+    long scoreBefore = game.score;
+    Bot<TETRIS_ENV_WIDTH, TETRIS_ENV_HEIGHT>::Apply(game, {piece, hold});
+    env->rewards[i] = static_cast<float>(game.score - scoreBefore);
+    env->dones[i] = game.gameOver;
+    if (game.gameOver) {
+        ++env->episodes[i];
+        game = Game(EpisodeSeed(env, i));
+    }
+    Observe(game, env->observations + i * TETRIS_ENV_OBS_SIZE);
+}
+
+static void StepSlice(TetrisEnv* env, size_t slice, size_t slices) {
+    size_t n = env->games.size();
+    size_t begin = n * slice / slices;
+    size_t end = n * (slice + 1) / slices;
+    for (size_t i = begin; i < end; ++i) {
+        StepGame(env, i);
+    }
+}
+
+static void WorkerLoop(TetrisEnv* env, size_t slice) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock lock{env->mutex};
+            env->wake.wait(lock, [&] { return env->quit || env->generation != seen; });
+            if (env->quit) {
+                return;
+            }
+            seen = env->generation;
+        }
+        StepSlice(env, slice, env->workers.size() + 1);
+        {
+            std::lock_guard lock{env->mutex};
+            if (--env->busy == 0) {
+                env->finished.notify_one();
+            }
+        }
+    }
+}
+
+
+extern "C" {
+
+TetrisEnv* tetris_env_create(size_t n, uint64_t seed, size_t threads) {
+    TetrisEnv* env = new TetrisEnv;
+    env->seed = seed;
+    env->episodes.assign(n, 0);
+    env->games.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        env->games.emplace_back(EpisodeSeed(env, i));
+    }
+    if (threads > n) {
+        threads = n;
+    }
+    // Slice 0 is stepped by the caller's thread
+    for (size_t slice = 1; slice < threads; ++slice) {
+        env->workers.emplace_back(WorkerLoop, env, slice);
+    }
+    return env;
+}
+
+void tetris_env_destroy(TetrisEnv* env) {
+    {
+        std::lock_guard lock{env->mutex};
+        env->quit = true;
+    }
+    env->wake.notify_all();
+    for (std::thread& worker : env->workers) {
+        worker.join();
+    }
+    delete env;
+}
+
+size_t tetris_env_count(const TetrisEnv* env) {
+    return env->games.size();
+}
+
+void tetris_env_reset(TetrisEnv* env, uint8_t* observations) {
+    for (size_t i = 0; i < env->games.size(); ++i) {
+        ++env->episodes[i];
+        env->games[i] = Game(EpisodeSeed(env, i));
+        Observe(env->games[i], observations + i * TETRIS_ENV_OBS_SIZE);
+    }
+}
+
+void tetris_env_step(TetrisEnv* env, const int32_t* actions,
+                     uint8_t* observations, float* rewards, uint8_t* dones) {
+    env->actions = actions;
+    env->observations = observations;
+    env->rewards = rewards;
+    env->dones = dones;
+
+    if (env->workers.empty()) {
+        StepSlice(env, 0, 1);
+        return;
+    }
+
+    {
+        std::lock_guard lock{env->mutex};
+        env->busy = env->workers.size();
+        ++env->generation;
+    }
+    env->wake.notify_all();
+    StepSlice(env, 0, env->workers.size() + 1);
+
+    std::unique_lock lock{env->mutex};
+    env->finished.wait(lock, [&] { return env->busy == 0; });
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+ * C interface to N independent headless games, for reinforcement-learning
+ * training loops. All buffers are owned by the caller and written in place:
+ *
+ *   observations  uint8_t[n][TETRIS_ENV_OBS_SIZE]
+ *   rewards       float[n]
+ *   dones         uint8_t[n]
+ *
+ * An observation is the board (row-major, 1 = filled) followed by the current
+ * piece type, the hold type and the next TETRIS_ENV_QUEUE piece types
+ * (0 = none, 1..7 = I J L O S T Z).
+ *
+ * An action picks a placement: hold * TETRIS_ENV_ROTATIONS * TETRIS_ENV_COLUMNS
+ * + rotation * TETRIS_ENV_COLUMNS + column. Column c puts the piece centre at
+ * x = c - 2. Placements that cannot be reached from the spawn row drop the
+ * piece where it spawned instead.
+ *
+ * The reward is the score gained by the step. A finished game is reset
+ * straight away; its done flag is set and the observation is the first state
+ * of the next game.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#define TETRIS_ENV_API __declspec(dllexport)
+#else
+#define TETRIS_ENV_API __attribute__((visibility("default")))
+#endif
+
+#define TETRIS_ENV_WIDTH 10
+#define TETRIS_ENV_HEIGHT 20
+#define TETRIS_ENV_QUEUE 5
+#define TETRIS_ENV_OBS_SIZE (TETRIS_ENV_WIDTH * TETRIS_ENV_HEIGHT + 2 + TETRIS_ENV_QUEUE)
+#define TETRIS_ENV_ROTATIONS 4
+#define TETRIS_ENV_COLUMNS (TETRIS_ENV_WIDTH + 4)
+#define TETRIS_ENV_ACTIONS (2 * TETRIS_ENV_ROTATIONS * TETRIS_ENV_COLUMNS)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct TetrisEnv TetrisEnv;
+
+/* threads = 0 or 1 steps every game on the calling thread */
+TETRIS_ENV_API TetrisEnv* tetris_env_create(size_t n, uint64_t seed, size_t threads);
+TETRIS_ENV_API void tetris_env_destroy(TetrisEnv* env);
+TETRIS_ENV_API size_t tetris_env_count(const TetrisEnv* env);
+
+TETRIS_ENV_API void tetris_env_reset(TetrisEnv* env, uint8_t* observations);
+TETRIS_ENV_API void tetris_env_step(TetrisEnv* env, const int32_t* actions,
+                                    uint8_t* observations, float* rewards, uint8_t* dones);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,317 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include "tetris.hpp"
+#include "bot.hpp"
+#include "parallel.hpp"
+#include "transposition.hpp"
+
+// Headless bot-vs-bot versus matches. Bot B (the candidate) plays bot A (the
+// baseline) over seeded matches on every core; the Elo difference and its
+// confidence interval are updated after every match and the run stops as soon
+// as the SPRT accepts or rejects the candidate.
+//
+// Every match is a pure function of its seed, so a surprising result can be
+// replayed on its own with --match.
+
+
+// Garbage lines sent for clearing 0..4 lines at once
+static constexpr int8_t AttackTable[5] = {0, 0, 1, 2, 4};
+static constexpr size_t MaxPieces = 2000;
+// Both sides also receive a line of garbage every so often, more often as the
+// match goes on, so that two solid bots cannot stall forever
+static constexpr size_t PressureStart = 12;
+static constexpr size_t PressureRamp = 150;
+
+struct MatchResult {
+    int winner; // 0 = A, 1 = B, -1 = draw
+    size_t pieces;
+};
+
+// tables is null or holds one transposition table per side
+MatchResult PlayMatch(uint64_t seed, Bot<> a, Bot<> b, TranspositionTable* const* tables, bool verbose) {
+    // Both sides see the same pieces and the same garbage holes
+    Tetris<> games[2] = {Tetris<>(seed), Tetris<>(seed)};
+    std::minstd_rand holeRng[2] = {
+        std::minstd_rand(static_cast<uint32_t>(seed >> 32)),
+        std::minstd_rand(static_cast<uint32_t>(seed >> 32)),
+    };
+    Bot<> const* bots[2] = {&a, &b};
+    if (tables) {
+        a.table = tables[0];
+        b.table = tables[1];
+        tables[0]->Clear();
+        tables[1]->Clear();
+    }
+    int pending[2] = {0, 0};
+
+    for (size_t pieces = 0; pieces < MaxPieces; ++pieces) {
+        int attack[2];
+        for (size_t i = 0; i < 2; ++i) {
+            bots[i]->Move(games[i]);
+            attack[i] = AttackTable[std::min(games[i].lastLinesCleared, 4)];
+
+            // Outgoing lines cancel incoming garbage first
+            int cancelled = std::min(attack[i], pending[i]);
+            pending[i] -= cancelled;
+            attack[i] -= cancelled;
+        }
+        for (size_t i = 0; i < 2; ++i) {
+            pending[1-i] += attack[i];
+        }
+        size_t interval = PressureStart - std::min(pieces / PressureRamp, PressureStart - 1);
+        if ((pieces + 1) % interval == 0) {
+            ++pending[0];
+            ++pending[1];
+        }
+        for (size_t i = 0; i < 2; ++i) {
+            if (games[i].lastLinesCleared == 0 && pending[i] > 0) {
+                int8_t hole = static_cast<int8_t>(holeRng[i]() % 10);
+                games[i].AddGarbage(static_cast<int8_t>(pending[i]), hole);
+                pending[i] = 0;
+            }
+        }
+
+        if (verbose) {
+            printf("piece %4zu  A: score %6ld pending %2d  B: score %6ld pending %2d\n",
+                   pieces, games[0].score, pending[0], games[1].score, pending[1]);
+        }
+
+        if (games[0].gameOver || games[1].gameOver) {
+            int winner = games[0].gameOver == games[1].gameOver ? -1 : games[0].gameOver ? 1 : 0;
+            return {winner, pieces+1};
+        }
+    }
+    return {-1, MaxPieces};
+}
+
+
+// Results from B's point of view
+struct Stats {
+    size_t wins = 0;
+    size_t draws = 0;
+    size_t losses = 0;
+
+    // Half a game of each outcome is added before estimating the variance,
+    // so that one-sided results (no losses or no wins yet) still have a
+    // spread. Without it the most lopsided runs could never stop the SPRT.
+    static constexpr double PriorGames = 0.5;
+
+    size_t Games() const { return wins + draws + losses; }
+
+    double Score(double prior = 0) const {
+        return (static_cast<double>(wins) + prior + 0.5 * (static_cast<double>(draws) + prior)) /
+               (static_cast<double>(Games()) + 3 * prior);
+    }
+
+    // Per-game variance of the score, with the pseudo-games above
+    double Variance() const {
+        double s = Score(PriorGames);
+        double w = static_cast<double>(wins) + PriorGames;
+        double d = static_cast<double>(draws) + PriorGames;
+        double l = static_cast<double>(losses) + PriorGames;
+        return (w * (1-s) * (1-s) + d * (0.5-s) * (0.5-s) + l * s * s) / (w + d + l);
+    }
+
+    static double ScoreToElo(double score) {
+        score = std::clamp(score, 1e-6, 1 - 1e-6);
+        return -400.0 * log10(1.0 / score - 1.0);
+    }
+
+    static double EloToScore(double elo) {
+        return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+    }
+
+    double Elo() const { return ScoreToElo(Score()); }
+
+    // Half-width of the 95% confidence interval, in Elo
+    double EloMargin() const {
+        double margin = 1.959964 * sqrt(Variance() / static_cast<double>(Games()));
+        return (ScoreToElo(Score() + margin) - ScoreToElo(Score() - margin)) / 2;
+    }
+
+    // Log-likelihood ratio of H1 (elo1) over H0 (elo0), trinomial approximation
+    double LLR(double elo0, double elo1) const {
+        if (Games() == 0) {
+            return 0.0;
+        }
+        double s0 = EloToScore(elo0);
+        double s1 = EloToScore(elo1);
+        double n = static_cast<double>(Games());
+        return n * (s1 - s0) * (2 * Score(PriorGames) - s0 - s1) / (2 * Variance());
+    }
+};
+
+// Feeds the SPRT synthetic results and checks it stops where it must: a
+// candidate that wins (or loses) every game is decided within a few dozen
+// games, and an even match is not accepted either way early on
+static int SelfTest() {
+    double lowerBound = log(0.05 / 0.95);
+    double upperBound = log(0.95 / 0.05);
+    auto GamesToDecide = [&](auto&& outcome, size_t maxGames, double& llr) {
+        Stats stats;
+        for (size_t game = 0; game < maxGames; ++game) {
+            int result = outcome(game);
+            if (result > 0) ++stats.wins;
+            else if (result < 0) ++stats.losses;
+            else ++stats.draws;
+            llr = stats.LLR(0, 10);
+            if (llr >= upperBound || llr <= lowerBound) {
+                return game + 1;
+            }
+        }
+        return maxGames + 1;
+    };
+
+    int failures = 0;
+    auto Check = [&](const char* name, bool ok, size_t games, double llr) {
+        printf("%-34s %s (%zu games, LLR %.2f)\n", name, ok ? "ok" : "FAILED", games, llr);
+        failures += !ok;
+    };
+    double llr = 0;
+    size_t games = GamesToDecide([](size_t) { return 1; }, 50, llr);
+    Check("all wins accept H1 early", games <= 50 && llr >= upperBound, games, llr);
+    games = GamesToDecide([](size_t) { return -1; }, 50, llr);
+    Check("all losses accept H0 early", games <= 50 && llr <= lowerBound, games, llr);
+    games = GamesToDecide([](size_t game) { return game % 10 == 0 ? 0 : 1; }, 50, llr);
+    Check("wins and draws accept H1 early", games <= 50 && llr >= upperBound, games, llr);
+    games = GamesToDecide([](size_t game) { return game % 2 ? 1 : -1; }, 100, llr);
+    Check("even match is not accepted as H1", games > 100 || llr <= lowerBound, games, llr);
+
+    Stats dominant;
+    dominant.wins = 300;
+    Check("a one-sided result has a margin", dominant.EloMargin() > 0, dominant.Games(), dominant.LLR(0, 10));
+    return failures ? 1 : 0;
+}
+
+
+void Usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --a W          baseline weights height,lines,holes,bumpiness\n"
+        "  --b W          candidate weights\n"
+        "  --games N      maximum number of matches (default 100000)\n"
+        "  --threads N    worker threads (default: all cores)\n"
+        "  --seed N       base seed (default 1)\n"
+        "  --elo0 E       SPRT null hypothesis (default 0)\n"
+        "  --elo1 E       SPRT alternative hypothesis (default 10)\n"
+        "  --alpha P      SPRT type I error (default 0.05)\n"
+        "  --beta P       SPRT type II error (default 0.05)\n"
+        "  --depth N      pieces both bots search ahead (default 1)\n"
+        "  --table-mb N   transposition table per bot when searching deeper (default 16)\n"
+        "  --match K      replay match K on its own and print every piece\n"
+        "  --self-test    check the SPRT stops on synthetic results, then exit\n",
+        program);
+}
+
+int main(int argc, char* argv[])
+{
+    Bot<> a, b;
+    size_t maxGames = 100000;
+    size_t threads = DefaultThreadCount();
+    uint64_t seed = 1;
+    double elo0 = 0, elo1 = 10, alpha = 0.05, beta = 0.05;
+    long replayMatch = -1;
+    size_t tableMegabytes = 16;
+
+    if (argc == 2 && strcmp(argv[1], "--self-test") == 0) {
+        return SelfTest();
+    }
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i+1 < argc ? argv[i+1] : nullptr;
+        if (!value) {
+            Usage(argv[0]);
+            return 1;
+        }
+        ++i;
+        if (strcmp(arg, "--a") == 0 && BotWeights::Parse(value, a.weights)) {}
+        else if (strcmp(arg, "--b") == 0 && BotWeights::Parse(value, b.weights)) {}
+        else if (strcmp(arg, "--games") == 0) maxGames = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--threads") == 0) threads = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--seed") == 0) seed = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--elo0") == 0) elo0 = atof(value);
+        else if (strcmp(arg, "--elo1") == 0) elo1 = atof(value);
+        else if (strcmp(arg, "--alpha") == 0) alpha = atof(value);
+        else if (strcmp(arg, "--beta") == 0) beta = atof(value);
+        else if (strcmp(arg, "--depth") == 0) a.depth = b.depth = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--table-mb") == 0) tableMegabytes = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--match") == 0) replayMatch = atol(value);
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // A pair of tables per worker, reused from match to match
+    std::vector<std::unique_ptr<TranspositionTable>> tableStorage;
+    std::vector<TranspositionTable*> tables;
+    if (a.depth > 1) {
+        for (size_t i = 0; i < 2 * threads; ++i) {
+            tableStorage.push_back(std::make_unique<TranspositionTable>(tableMegabytes));
+            tables.push_back(tableStorage.back().get());
+        }
+    }
+    auto WorkerTables = [&](size_t worker) -> TranspositionTable* const* {
+        return tables.empty() ? nullptr : &tables[2 * worker];
+    };
+
+    if (replayMatch >= 0) {
+        MatchResult result = PlayMatch(DeriveSeed(seed, static_cast<size_t>(replayMatch)), a, b, WorkerTables(0), true);
+        printf("match %ld: %s after %zu pieces\n", replayMatch,
+               result.winner < 0 ? "draw" : result.winner == 0 ? "A wins" : "B wins", result.pieces);
+        return 0;
+    }
+
+    double lowerBound = log(beta / (1 - alpha));
+    double upperBound = log((1 - beta) / alpha);
+
+    printf("A: "); a.weights.Print(stdout); printf("\n");
+    printf("B: "); b.weights.Print(stdout); printf("\n");
+    printf("%zu threads, SPRT elo0=%.1f elo1=%.1f alpha=%.3f beta=%.3f\n", threads, elo0, elo1, alpha, beta);
+
+    std::mutex statsMutex;
+    Stats stats;
+    const char* verdict = "inconclusive";
+    auto start = std::chrono::steady_clock::now();
+
+    ParallelFor(maxGames, threads, [&](size_t match, size_t worker) {
+        MatchResult result = PlayMatch(DeriveSeed(seed, match), a, b, WorkerTables(worker), false);
+
+        std::lock_guard lock{statsMutex};
+        if (result.winner == 1) ++stats.wins;
+        else if (result.winner == 0) ++stats.losses;
+        else ++stats.draws;
+
+        double llr = stats.LLR(elo0, elo1);
+        if (stats.Games() % 64 == 0) {
+            fprintf(stderr, "%6zu games  W %zu D %zu L %zu  Elo %+.1f +- %.1f  LLR %.2f [%.2f, %.2f]\n",
+                    stats.Games(), stats.wins, stats.draws, stats.losses,
+                    stats.Elo(), stats.EloMargin(), llr, lowerBound, upperBound);
+        }
+        if (llr >= upperBound) {
+            verdict = "H1 accepted (B is stronger)";
+            return false;
+        }
+        if (llr <= lowerBound) {
+            verdict = "H0 accepted (B is not stronger)";
+            return false;
+        }
+        return true;
+    });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%zu games in %.1fs  W %zu D %zu L %zu\n", stats.Games(), seconds, stats.wins, stats.draws, stats.losses);
+    printf("Elo %+.1f +- %.1f (95%%)  LLR %.2f\n", stats.Elo(), stats.EloMargin(), stats.LLR(elo0, elo1));
+    printf("SPRT: %s\n", verdict);
+    return 0;
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define TRACE_TSC 1
+#endif
+
+// Timeline tracer, compiled in with -DTETRIS_TRACE. Writes the Chrome
+// trace_event JSON format, which chrome://tracing and Perfetto open.
+//
+// Each thread records into its own ring buffer, so a span is two clock reads
+// and one store with no locks or atomics. On x86 the clock is the TSC, which
+// is read in a fraction of the time of steady_clock; ticks are converted to
+// nanoseconds against the steady clock when the trace is written. When a ring
+// fills, the oldest events are overwritten. A thread that exits hands its
+// ring to the next new thread, so ParallelFor starting fresh workers on every
+// call reuses the same few rings (and timeline rows) instead of adding one
+// per thread ever started. Rings are only read by WriteJson(), which is meant
+// to run after the traced threads have stopped.
+
+struct TraceEvent {
+    const char* name;   // Must be a string literal
+    int64_t start;      // Tracer::Ticks()
+    int64_t duration;   // Ticks, -1 for an instant event
+    int64_t value;      // Shown as args.value
+};
+
+struct TraceRing {
+    static constexpr size_t Capacity = size_t{1} << 16;
+
+    std::unique_ptr<TraceEvent[]> events = std::make_unique<TraceEvent[]>(Capacity);
+    size_t count = 0;
+    uint32_t tid = 0;
+    const char* threadName = nullptr;
+
+    void Push(TraceEvent const& event) {
+        events[count++ & (Capacity - 1)] = event;
+    }
+};
+
+struct Tracer {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceRing>> rings;
+    std::vector<TraceRing*> freeRings;  // Left by threads that have exited
+    int64_t originTicks = Ticks();
+    int64_t originNanoseconds = Nanoseconds();
+
+    static int64_t Nanoseconds() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static int64_t Ticks() {
+#ifdef TRACE_TSC
+        return static_cast<int64_t>(__rdtsc());
+#else
+        return Nanoseconds();
+#endif
+    }
+
+    // Nanoseconds per tick, measured from construction until now
+    double TickLength() const {
+        int64_t ticks = Ticks() - originTicks;
+        int64_t nanoseconds = Nanoseconds() - originNanoseconds;
+        return ticks > 0 && nanoseconds > 0 ? static_cast<double>(nanoseconds) / static_cast<double>(ticks) : 1.0;
+    }
+
+    // A thread's ring, given back to the tracer when the thread exits
+    struct RingLease {
+        Tracer* tracer = nullptr;
+        TraceRing* ring = nullptr;
+
+        ~RingLease() {
+            if (ring) {
+                std::lock_guard lock{tracer->mutex};
+                tracer->freeRings.push_back(ring);
+            }
+        }
+    };
+
+    // First use on each thread takes a free ring, or registers a new one
+    TraceRing& Ring() {
+        thread_local RingLease lease;
+        if (!lease.ring) {
+            std::lock_guard lock{mutex};
+            lease.tracer = this;
+            if (!freeRings.empty()) {
+                lease.ring = freeRings.back();
+                freeRings.pop_back();
+            }
+            else {
+                rings.push_back(std::make_unique<TraceRing>());
+                lease.ring = rings.back().get();
+                lease.ring->tid = static_cast<uint32_t>(rings.size());
+            }
+        }
+        return *lease.ring;
+    }
+
+    void Instant(const char* name, int64_t value) {
+        Ring().Push({name, Ticks(), -1, value});
+    }
+
+    // For events that happened before they reached us, like key presses
+    void InstantAgo(const char* name, int64_t value, int64_t nanosecondsAgo) {
+        int64_t ago = static_cast<int64_t>(static_cast<double>(nanosecondsAgo) / TickLength());
+        Ring().Push({name, Ticks() - ago, -1, value});
+    }
+
+    bool WriteJson(const char* path) {
+        FILE* file = fopen(path, "w");
+        if (!file) {
+            return false;
+        }
+        std::lock_guard lock{mutex};
+        // Microseconds since the tracer was created
+        double tickLength = TickLength();
+        auto Micros = [&](int64_t ticks) {
+            return static_cast<double>(ticks) * tickLength / 1000;
+        };
+        fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        const char* separator = "";
+        for (auto const& ring : rings) {
+            if (ring->threadName) {
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                        separator, ring->tid, ring->threadName);
+                separator = ",\n";
+            }
+            size_t first = ring->count > TraceRing::Capacity ? ring->count - TraceRing::Capacity : 0;
+            for (size_t i = first; i < ring->count; ++i) {
+                TraceEvent const& e = ring->events[i & (TraceRing::Capacity - 1)];
+                if (e.duration < 0) {
+                    fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"value\":%lld}}",
+                            separator, e.name, Micros(e.start - originTicks), ring->tid,
+                            static_cast<long long>(e.value));
+                }
+                else {
+                    fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"value\":%lld}}",
+                            separator, e.name, Micros(e.start - originTicks),
+                            Micros(e.duration), ring->tid,
+                            static_cast<long long>(e.value));
+                }
+                separator = ",\n";
+            }
+        }
+        fprintf(file, "\n]}\n");
+        return fclose(file) == 0;
+    }
+};
+
+struct TraceScope {
+    TraceRing& ring;
+    const char* name;
+    int64_t value;
+    int64_t start = Tracer::Ticks();
+
+    ~TraceScope() {
+        ring.Push({name, start, Tracer::Ticks() - start, value});
+    }
+};
+
+#ifdef TETRIS_TRACE
+inline Tracer tracer;
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__){tracer.Ring(), name, 0}
+#define TRACE_SCOPE_VALUE(name, value) TraceScope TRACE_CONCAT(traceScope, __LINE__){tracer.Ring(), name, static_cast<int64_t>(value)}
+#define TRACE_INSTANT(name, value) tracer.Instant(name, static_cast<int64_t>(value))
+#define TRACE_INSTANT_AGO(name, value, nanoseconds) tracer.InstantAgo(name, static_cast<int64_t>(value), nanoseconds)
+#define TRACE_THREAD_NAME(name) (tracer.Ring().threadName = name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SCOPE_VALUE(name, value) ((void)0)
+#define TRACE_INSTANT(name, value) ((void)0)
+#define TRACE_INSTANT_AGO(name, value, nanoseconds) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
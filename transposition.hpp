@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <atomic>
+#include <memory>
+
+
+// Fixed-size transposition table shared by search threads without locks.
+//
+// Each entry stores key ^ data next to data. A reader that races a writer sees
+// a mix of two entries, the check fails and the probe is a miss, so no lock is
+// needed. Entries live in buckets of four (one cache line). A store replaces
+// the same key if present, then an empty slot, then the slot that is shallowest
+// once older searches are penalised.
+//
+// The entries can also live in memory the caller owns, such as a writable
+// MappedFile, so what one process stores the next one finds. They are plain
+// words accessed through std::atomic_ref, so zeroed or previously written
+// bytes are valid entries without constructing anything over them.
+struct TranspositionTable {
+    struct Entry {
+        uint64_t check = 0;
+        uint64_t data = 0;
+    };
+    static constexpr size_t BucketSize = 4;
+
+    static_assert(sizeof(Entry) == 16 && alignof(uint64_t) >= std::atomic_ref<uint64_t>::required_alignment &&
+                  std::atomic_ref<uint64_t>::is_always_lock_free,
+                  "entries are plain pairs of words, so they can be laid over raw memory");
+
+    std::unique_ptr<Entry[]> storage;  // Null when the caller owns the entries
+    Entry* entries;
+    size_t bucketMask;
+    uint8_t ownAge = 0;
+    uint8_t* age = &ownAge;  // The caller's when it owns the entries
+
+    static uint64_t Load(uint64_t& word) {
+        return std::atomic_ref<uint64_t>(word).load(std::memory_order_relaxed);
+    }
+
+    static void Put(uint64_t& word, uint64_t value) {
+        std::atomic_ref<uint64_t>(word).store(value, std::memory_order_relaxed);
+    }
+
+    // Largest power of two number of buckets that fits in `bytes`
+    static size_t BucketsFor(size_t bytes) {
+        size_t buckets = 1;
+        while (buckets * 2 * BucketSize * sizeof(Entry) <= bytes) {
+            buckets *= 2;
+        }
+        return buckets;
+    }
+
+    explicit TranspositionTable(size_t megabytes) {
+        size_t buckets = BucketsFor(megabytes << 20);
+        storage = std::make_unique<Entry[]>(buckets * BucketSize);
+        entries = storage.get();
+        bucketMask = buckets - 1;
+    }
+
+    // Uses the zeroed or previously stored entries at `memory` as they are,
+    // and the search age at `storedAge`, so entries keep their age across
+    // runs. Both must outlive the table; memory must be 16-byte aligned.
+    TranspositionTable(void* memory, size_t bytes, uint8_t* storedAge) {
+        entries = static_cast<Entry*>(memory);
+        bucketMask = BucketsFor(bytes) - 1;
+        age = storedAge;
+    }
+
+    // `age` may point into the table itself
+    TranspositionTable(TranspositionTable const&) = delete;
+    TranspositionTable& operator=(TranspositionTable const&) = delete;
+
+    void Clear() {
+        for (size_t i = 0; i <= bucketMask; ++i) {
+            for (size_t j = 0; j < BucketSize; ++j) {
+                Put(entries[i * BucketSize + j].check, 0);
+                Put(entries[i * BucketSize + j].data, 0);
+            }
+        }
+    }
+
+    // Entries from earlier searches become the first to be replaced
+    void NewSearch() {
+        std::atomic_ref<uint8_t>(*age).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // data: bits 0-31 value, 32-39 depth (0 = empty), 40-47 age
+    static uint64_t Pack(float value, uint8_t depth, uint8_t age) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits | uint64_t{depth} << 32 | uint64_t{age} << 40;
+    }
+
+    static uint8_t Depth(uint64_t data) { return static_cast<uint8_t>(data >> 32); }
+    static uint8_t Age(uint64_t data) { return static_cast<uint8_t>(data >> 40); }
+
+    static float Value(uint64_t data) {
+        uint32_t bits = static_cast<uint32_t>(data);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    Entry* Bucket(uint64_t key) const {
+        return &entries[(key & bucketMask) * BucketSize];
+    }
+
+    // Hit only if the stored result was searched at least minDepth deep
+    bool Probe(uint64_t key, uint8_t minDepth, float& value) const {
+        Entry* bucket = Bucket(key);
+        for (size_t i = 0; i < BucketSize; ++i) {
+            uint64_t data = Load(bucket[i].data);
+            uint64_t check = Load(bucket[i].check);
+            if ((check ^ data) == key && Depth(data) >= minDepth && Depth(data) > 0) {
+                value = Value(data);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Store(uint64_t key, uint8_t depth, float value) {
+        uint8_t currentAge = std::atomic_ref<uint8_t>(*age).load(std::memory_order_relaxed);
+        Entry* bucket = Bucket(key);
+        Entry* victim = &bucket[0];
+        int victimWorth = 1 << 30;
+        for (size_t i = 0; i < BucketSize; ++i) {
+            uint64_t data = Load(bucket[i].data);
+            uint64_t check = Load(bucket[i].check);
+            if ((check ^ data) == key && Depth(data) > 0) {
+                if (Depth(data) > depth && Age(data) == currentAge) {
+                    return;
+                }
+                victim = &bucket[i];
+                break;
+            }
+            int worth = Depth(data) == 0 ? -1 :
+                Depth(data) - 4 * static_cast<uint8_t>(currentAge - Age(data));
+            if (worth < victimWorth) {
+                victimWorth = worth;
+                victim = &bucket[i];
+            }
+        }
+        uint64_t data = Pack(value, depth, currentAge);
+        Put(victim->check, key ^ data);
+        Put(victim->data, data);
+    }
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+
+
+// Hands the latest value from one writer thread to one reader thread without
+// locks. The writer fills its back slot and swaps it with the middle one; the
+// reader swaps the middle slot into front when it holds something newer. Each
+// side only ever touches its own slot, so the reader always sees a complete
+// value and neither side waits for the other.
+template<typename T>
+struct TripleBuffer {
+    static constexpr uint8_t Fresh = 4;  // Set on middle when it is unread
+
+    T slots[3]{};
+    std::atomic<uint8_t> middle{1};
+    uint8_t back = 0;
+    uint8_t front = 2;
+
+    // Writer side: fill Back() then Publish()
+    T& Back() { return slots[back]; }
+
+    void Publish() {
+        uint8_t previous = middle.exchange(back | Fresh, std::memory_order_acq_rel);
+        back = previous & ~Fresh;
+    }
+
+    // Reader side: returns true if Front() changed since the last call
+    bool Acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & Fresh)) {
+            return false;
+        }
+        uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & ~Fresh;
+        return true;
+    }
+
+    T const& Front() const { return slots[front]; }
+};
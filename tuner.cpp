@@ -0,0 +1,285 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tetris.hpp"
+#include "bot.hpp"
+#include "parallel.hpp"
+
+// Tunes the bot evaluation weights with a separable CMA-ES (diagonal
+// covariance, Ros & Hansen 2008). Every candidate of a generation is scored on
+// the same seeded games (common random numbers), so the ranking compares
+// weights rather than luck. The optimiser state is written to the checkpoint
+// file after every generation and a run picks up from it with --resume.
+
+
+static constexpr size_t N = BotWeights::COUNT;
+
+// Pieces placed before topping out under a steady stream of garbage.
+// Capped, since a good bot survives a long time.
+size_t PlaySolo(uint64_t seed, Bot<> const& bot, size_t pressure, size_t maxPieces) {
+    Tetris<> game(seed);
+    std::minstd_rand holeRng(static_cast<uint32_t>(seed >> 32));
+    for (size_t pieces = 0; pieces < maxPieces; ++pieces) {
+        bot.Move(game);
+        if (game.lastLinesCleared == 0 && (pieces + 1) % pressure == 0) {
+            game.AddGarbage(1, static_cast<int8_t>(holeRng() % 10));
+        }
+        if (game.gameOver) {
+            return pieces + 1;
+        }
+    }
+    return maxPieces;
+}
+
+
+struct Optimizer {
+    size_t generation = 0;
+    double sigma = 0.3;
+    double mean[N];
+    double variance[N];  // Diagonal of the covariance matrix
+    double pathSigma[N] = {};
+    double pathC[N] = {};
+    double bestFitness = -1;
+    double best[N];
+    std::mt19937_64 rng{1};
+
+    Optimizer() {
+        BotWeights defaults;
+        for (size_t i = 0; i < N; ++i) {
+            mean[i] = defaults.w[i];
+            variance[i] = 1.0;
+            best[i] = defaults.w[i];
+        }
+    }
+
+    bool Save(const char* path) const {
+        // Write then rename so a crash mid-write keeps the previous checkpoint
+        std::string temp = std::string(path) + ".tmp";
+        {
+            std::ofstream out(temp);
+            out.precision(17);
+            out << generation << ' ' << sigma << ' ' << bestFitness << '\n';
+            for (double const* array : {mean, variance, pathSigma, pathC, best}) {
+                for (size_t i = 0; i < N; ++i) {
+                    out << array[i] << ' ';
+                }
+                out << '\n';
+            }
+            out << rng << '\n';
+            if (!out) {
+                return false;
+            }
+        }
+        return rename(temp.c_str(), path) == 0;
+    }
+
+    bool Load(const char* path) {
+        std::ifstream in(path);
+        in >> generation >> sigma >> bestFitness;
+        for (double* array : {mean, variance, pathSigma, pathC, best}) {
+            for (size_t i = 0; i < N; ++i) {
+                in >> array[i];
+            }
+        }
+        in >> rng;
+        return static_cast<bool>(in);
+    }
+};
+
+
+void Usage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --generations N  generations to run (default 50)\n"
+        "  --population N   candidates per generation (default 16)\n"
+        "  --games N        seeded games per candidate (default 32)\n"
+        "  --pieces N       piece cap per game (default 1000)\n"
+        "  --pressure N     one garbage line every N pieces (default 4)\n"
+        "  --threads N      worker threads (default: all cores)\n"
+        "  --seed N         base seed (default 1)\n"
+        "  --checkpoint F   checkpoint file (default tuner.ckpt)\n"
+        "  --resume         continue from the checkpoint file\n",
+        program);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t generations = 50;
+    size_t lambda = 16;
+    size_t games = 32;
+    size_t maxPieces = 1000;
+    size_t pressure = 4;
+    size_t threads = DefaultThreadCount();
+    uint64_t seed = 1;
+    const char* checkpoint = "tuner.ckpt";
+    bool resume = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--resume") == 0) {
+            resume = true;
+            continue;
+        }
+        const char* value = i+1 < argc ? argv[++i] : nullptr;
+        if (!value) {
+            Usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(arg, "--generations") == 0) generations = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--population") == 0) lambda = std::max(4ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--games") == 0) games = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--pieces") == 0) maxPieces = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--pressure") == 0) pressure = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--threads") == 0) threads = std::max(1ull, strtoull(value, nullptr, 10));
+        else if (strcmp(arg, "--seed") == 0) seed = strtoull(value, nullptr, 10);
+        else if (strcmp(arg, "--checkpoint") == 0) checkpoint = value;
+        else {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Optimizer opt;
+    opt.rng.seed(seed);
+    if (resume) {
+        if (!opt.Load(checkpoint)) {
+            fprintf(stderr, "Failed to read checkpoint %s\n", checkpoint);
+            return 1;
+        }
+        printf("Resuming from generation %zu\n", opt.generation);
+    }
+
+    // Strategy parameters
+    size_t mu = lambda / 2;
+    std::vector<double> recombination(mu);
+    for (size_t i = 0; i < mu; ++i) {
+        recombination[i] = log(static_cast<double>(mu) + 0.5) - log(static_cast<double>(i + 1));
+    }
+    double weightSum = std::accumulate(recombination.begin(), recombination.end(), 0.0);
+    double weightSquares = 0;
+    for (double& w : recombination) {
+        w /= weightSum;
+        weightSquares += w * w;
+    }
+    double n = static_cast<double>(N);
+    double muEff = 1.0 / weightSquares;
+    double cSigma = (muEff + 2) / (n + muEff + 5);
+    double dSigma = 1 + 2 * std::max(0.0, sqrt((muEff - 1) / (n + 1)) - 1) + cSigma;
+    double cC = (4 + muEff / n) / (n + 4 + 2 * muEff / n);
+    double c1 = 2 / ((n + 1.3) * (n + 1.3) + muEff);
+    double cMu = std::min(1 - c1, 2 * (muEff - 2 + 1 / muEff) / ((n + 2) * (n + 2) + muEff));
+    // The diagonal-only update can learn faster than the full one
+    c1 = std::min(1.0, c1 * (n + 2) / 3);
+    cMu = std::min(1 - c1, cMu * (n + 2) / 3);
+    double chiN = sqrt(n) * (1 - 1 / (4 * n) + 1 / (21 * n * n));
+
+    std::vector<BotWeights> candidates(lambda);
+    std::vector<double> steps(lambda * N);  // (x - mean) / sigma
+    std::vector<double> fitness(lambda);
+    std::vector<size_t> survived(lambda * games);
+
+    for (; opt.generation < generations; ++opt.generation) {
+        // Fresh per generation so a resumed run draws the same samples
+        std::normal_distribution<double> normal;
+        for (size_t k = 0; k < lambda; ++k) {
+            for (size_t i = 0; i < N; ++i) {
+                double step = sqrt(opt.variance[i]) * normal(opt.rng);
+                steps[k * N + i] = step;
+                candidates[k].w[i] = opt.mean[i] + opt.sigma * step;
+            }
+        }
+
+        // Common random numbers: game g has the same seed for every candidate
+        uint64_t generationSeed = DeriveSeed(seed, opt.generation);
+        ParallelFor(lambda * games, threads, [&](size_t job, size_t) {
+            size_t k = job / games;
+            size_t g = job % games;
+            survived[job] = PlaySolo(DeriveSeed(generationSeed, g), Bot<>{candidates[k]}, pressure, maxPieces);
+            return true;
+        });
+        for (size_t k = 0; k < lambda; ++k) {
+            size_t total = std::accumulate(survived.begin() + k * games, survived.begin() + (k + 1) * games, size_t{0});
+            fitness[k] = static_cast<double>(total) / static_cast<double>(games);
+        }
+
+        std::vector<size_t> order(lambda);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return fitness[a] > fitness[b]; });
+
+        if (fitness[order[0]] > opt.bestFitness) {
+            opt.bestFitness = fitness[order[0]];
+            std::copy(candidates[order[0]].w, candidates[order[0]].w + N, opt.best);
+        }
+
+        // Move the mean towards the best mu candidates
+        double meanStep[N] = {};
+        for (size_t r = 0; r < mu; ++r) {
+            for (size_t i = 0; i < N; ++i) {
+                meanStep[i] += recombination[r] * steps[order[r] * N + i];
+            }
+        }
+        for (size_t i = 0; i < N; ++i) {
+            opt.mean[i] += opt.sigma * meanStep[i];
+        }
+
+        // Evolution paths
+        double pathSigmaNorm = 0;
+        for (size_t i = 0; i < N; ++i) {
+            opt.pathSigma[i] = (1 - cSigma) * opt.pathSigma[i] +
+                sqrt(cSigma * (2 - cSigma) * muEff) * meanStep[i] / sqrt(opt.variance[i]);
+            pathSigmaNorm += opt.pathSigma[i] * opt.pathSigma[i];
+        }
+        pathSigmaNorm = sqrt(pathSigmaNorm);
+        double decay = 1 - pow(1 - cSigma, 2.0 * static_cast<double>(opt.generation + 1));
+        bool hSigma = pathSigmaNorm / sqrt(decay) < (1.4 + 2 / (n + 1)) * chiN;
+        for (size_t i = 0; i < N; ++i) {
+            opt.pathC[i] = (1 - cC) * opt.pathC[i] +
+                (hSigma ? sqrt(cC * (2 - cC) * muEff) * meanStep[i] : 0.0);
+        }
+
+        // Rank-one and rank-mu updates of the diagonal covariance
+        for (size_t i = 0; i < N; ++i) {
+            double rankMu = 0;
+            for (size_t r = 0; r < mu; ++r) {
+                double step = steps[order[r] * N + i];
+                rankMu += recombination[r] * step * step;
+            }
+            double rankOne = opt.pathC[i] * opt.pathC[i] +
+                (hSigma ? 0.0 : cC * (2 - cC) * opt.variance[i]);
+            opt.variance[i] = (1 - c1 - cMu) * opt.variance[i] + c1 * rankOne + cMu * rankMu;
+        }
+        opt.sigma *= exp((cSigma / dSigma) * (pathSigmaNorm / chiN - 1));
+
+        double meanFitness = std::accumulate(fitness.begin(), fitness.end(), 0.0) / static_cast<double>(lambda);
+        BotWeights meanWeights;
+        std::copy(opt.mean, opt.mean + N, meanWeights.w);
+        printf("gen %3zu  best %7.1f  mean %7.1f  sigma %.4f  mean ",
+               opt.generation, fitness[order[0]], meanFitness, opt.sigma);
+        meanWeights.Print(stdout);
+        printf("\n");
+        fflush(stdout);
+
+        Optimizer saved = opt;
+        ++saved.generation;
+        if (!saved.Save(checkpoint)) {
+            fprintf(stderr, "Failed to write checkpoint %s\n", checkpoint);
+        }
+    }
+
+    BotWeights bestWeights;
+    std::copy(opt.best, opt.best + N, bestWeights.w);
+    printf("best %.1f pieces: ", opt.bestFitness);
+    bestWeights.Print(stdout);
+    printf("\n");
+    return 0;
+}